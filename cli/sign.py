@@ -15,8 +15,67 @@ def checksummed(pk):
   sum = sha512_256.new(str(pk)).digest()
   return base64.b32encode(pk + sum[28:32]).replace("=", "")
 
+# Accounts searched for multisig subkeys, and signed at once.
+MSIG_SEARCH = 16
+MSIG_MAX = 3
+
+def find_account(pk):
+  # INS_FIND_ACCOUNT
+  apdu = "\x80\x0c\x00\x00" + struct.pack("B", 40) + str(pk)
+  apdu += struct.pack(">II", 0, MSIG_SEARCH)
+  try:
+    return struct.unpack(">I", str(dongle.exchange(bytes(apdu))))[0]
+  except CommException as comm:
+    if comm.sw == 0x6a88:
+      return None
+    raise
+
+def get_config():
+  # INS_GET_CONFIG, which older apps do not know
+  try:
+    config = str(dongle.exchange(bytes("\x80\x15\x00\x00\x00")))
+  except CommException as comm:
+    if comm.sw in (0x6d00, 0x6e00):
+      return None
+    raise
+  (ins_bits, txn_max, _, payload_max) = struct.unpack(">IHHB", config[4:13])
+  return (ins_bits, txn_max, payload_max)
+
+def supports(ins):
+  return config is not None and config[0] & (1 << ins) != 0
+
+def send_chunks(ins, p1_first, p1_next, tosend):
+  p1 = p1_first
+  p2 = 0x80
+  while p2 == 0x80:
+    thischunk = tosend[:chunk_size]
+    if len(thischunk) == len(tosend):
+      p2 = 0
+
+    # CLA
+    apdu = "\x80"
+
+    # INS
+    apdu += struct.pack("B", ins)
+
+    # P1, P2, LC
+    apdu += struct.pack("B", p1)
+    apdu += struct.pack("B", p2)
+    apdu += struct.pack("B", len(thischunk))
+
+    apdu += thischunk
+
+    response = dongle.exchange(apdu)
+
+    tosend = tosend[len(thischunk):]
+    p1 = p1_next
+  return response
+
 dongle = getDongle(debug=False)
 
+config = get_config()
+chunk_size = config[2] if config is not None else 250
+
 publicKey = dongle.exchange(bytes("8003000000".decode('hex')))
 print "Ledger app address:", checksummed(publicKey)
 
@@ -34,36 +93,73 @@ with open(infile) as f:
 try:
   txbytes = algomsgpack.encoded(intx)
 
-  tosend = txbytes
-
-  p1 = 0
-  p2 = 0x80
-  while p2 == 0x80:
-    thischunk = tosend[:250]
-    if len(thischunk) == len(tosend):
-      p2 = 0
-
-    # CLA
-    apdu = "\x80"
-
+  # Multisig subkeys held by the device, signed after a single review
+  signers = []
+  msig = instx.get('msig')
+  if msig is not None and msig.get('v') == 1:
+    for sub in msig['subsig']:
+      account = find_account(sub['pk'])
+      if account is not None and len(signers) < MSIG_MAX:
+        signers.append((account, sub))
+
+  # Transactions larger than the device's buffer are sent twice
+  stream = (not signers and config is not None and len(txbytes) > config[1]
+            and supports(0x09))
+
+  if signers:
+    # INS_SIGN_MULTISIG
+    tosend = struct.pack("B", len(signers))
+    for (account, _) in signers:
+      tosend += struct.pack(">I", account)
+    tosend += txbytes
+    signature = send_chunks(0x10, 0x00, 0x80, tosend)
+  elif stream:
+    # INS_SIGN_MSGPACK_STREAM: the review, then the signature
+    txid = send_chunks(0x09, 0x00, 0x80, txbytes)
+    if str(txid[:65]) == "\x00" * 65:
+      raise Exception("Error: %s" % txid[65:])
+    signature = send_chunks(0x09, 0x40, 0xc0, txbytes)
+  elif msig is None and supports(0x11):
+    # INS_SIGN_MSGPACK, the device assembling the SignedTxn itself
+    signature = send_chunks(0x08, 0x02, 0x80, txbytes)
+  else:
     # INS_SIGN_MSGPACK
-    apdu += "\x08"
+    signature = send_chunks(0x08, 0x00, 0x80, txbytes)
 
-    # P1, P2, LC
-    apdu += struct.pack("B", p1)
-    apdu += struct.pack("B", p2)
-    apdu += struct.pack("B", len(thischunk))
-
-    apdu += thischunk
-
-    signature = dongle.exchange(apdu)
-
-    tosend = tosend[len(thischunk):]
-    p1 = 0x80
-
-  if len(signature) > 64:
+  # Errors are 65 zero bytes and a message, unlike any signature
+  if str(signature[:65]) == "\x00" * 65:
     raise Exception("Error: %s" % signature[65:])
 
+  if msig is None and not stream and supports(0x11):
+    (length,) = struct.unpack(">H", str(signature[:2]))
+    stxn = str(signature[2:])
+    while len(stxn) < length:
+      # INS_GET_SIGNED_TXN, from the offset read so far
+      apdu = "\x80\x11\x00\x00\x02" + struct.pack(">H", len(stxn))
+      stxn += str(dongle.exchange(bytes(apdu)))
+
+    signature = msgpack.unpackb(stxn, raw=False)['sig']
+    print "signature " + str(signature).encode('hex')
+    ed25519.checkvalid(str(signature), 'TX' + txbytes, str(publicKey))
+    print "Verified signature"
+
+    with open(outfile, 'w') as f:
+      f.write(stxn)
+      print "Wrote signed transaction to %s" % outfile
+    sys.exit(0)
+
+  if signers:
+    for (i, (account, sub)) in enumerate(signers):
+      sub['s'] = signature[64*i:64*(i+1)]
+      print "account %d signature %s" % (account, str(sub['s']).encode('hex'))
+      ed25519.checkvalid(str(sub['s']), 'TX' + txbytes, str(sub['pk']))
+    print "Verified signatures"
+
+    with open(outfile, 'w') as f:
+      f.write(algomsgpack.encoded(instx))
+      print "Wrote signed transaction to %s" % outfile
+    sys.exit(0)
+
   print "signature " + str(signature).encode('hex')
 
   ed25519.checkvalid(str(signature), 'TX' + txbytes, str(publicKey))
@@ -6,13 +6,12 @@
 #include "base64.h"
 
 void
-checksummed_addr(const uint8_t *publicKey, char *out)
+sha512_256_init(cx_sha512_t *h)
 {
   // The SDK does not provide a ready-made SHA512/256, so we set up a SHA512
   // hash context, and then overwrite the IV with the SHA512/256-specific IV.
-  cx_sha512_t h;
-  memset(&h, 0, sizeof(h));
-  cx_sha512_init(&h);
+  memset(h, 0, sizeof(*h));
+  cx_sha512_init(h);
 
   static const uint64_t sha512_256_state[8] = {
     0x22312194fc2bf72c, 0x9f555fa3c84c64c2, 0x2393b86b6f53b151, 0x963877195940eabd,
@@ -22,18 +21,38 @@ checksummed_addr(const uint8_t *publicKey, char *out)
   for (int i = 0; i < 8; i++) {
     uint64_t iv = sha512_256_state[i];
     for (int j = 0; j < 8; j++) {
-      h.acc[i*8 + j] = iv & 0xff;
+      h->acc[i*8 + j] = iv & 0xff;
       iv = iv >> 8;
     }
   }
+}
+
+void
+addr_checksum(const uint8_t *publicKey, uint8_t *checksum)
+{
+  cx_sha512_t h;
+  sha512_256_init(&h);
 
   uint8_t hash[64];
   cx_hash(&h.header, CX_LAST, publicKey, 32, hash, sizeof(hash));
+  os_memmove(checksum, &hash[28], 4);
+}
 
+void
+addr_encode(const uint8_t *publicKey, const uint8_t *checksum, char *out)
+{
   uint8_t checksummed[36];
   os_memmove(&checksummed[0], publicKey, 32);
-  os_memmove(&checksummed[32], &hash[28], 4);
+  os_memmove(&checksummed[32], checksum, 4);
 
   os_memset(out, 0, 65);
   base32_encode(checksummed, sizeof(checksummed), (unsigned char*) out);
 }
+
+void
+checksummed_addr(const uint8_t *publicKey, char *out)
+{
+  uint8_t checksum[4];
+  addr_checksum(publicKey, checksum);
+  addr_encode(publicKey, checksum, out);
+}
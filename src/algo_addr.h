@@ -1,3 +1,15 @@
+#include "cx.h"
+
 // The input public key should be 32 bytes long.
 // The output buffer must be at least 65 bytes long.
 void checksummed_addr(const uint8_t *publicKey, char *out);
+
+// addr_checksum writes the 4-byte checksum of publicKey, which
+// addr_encode appends to it to write the address, as checksummed_addr
+// does.
+void addr_checksum(const uint8_t *publicKey, uint8_t *checksum);
+void addr_encode(const uint8_t *publicKey, const uint8_t *checksum, char *out);
+
+// sha512_256_init sets up a SHA512 context with the SHA512/256 IV.
+// The first 32 bytes of the final SHA512 output are the digest.
+void sha512_256_init(cx_sha512_t *h);
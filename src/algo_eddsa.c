@@ -0,0 +1,143 @@
+#include "os.h"
+#include "cx.h"
+#include "os_io_seproxyhal.h"
+
+#include "algo_keys.h"
+#include "algo_eddsa.h"
+
+// Group order L, big-endian.
+static const uint8_t ed25519_order[32] = {
+  0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x14, 0xde, 0xf9, 0xde, 0xa2, 0xf7, 0x9c, 0xd6, 0x58, 0x12, 0x63, 0x1a, 0x5c, 0xf5, 0xd3, 0xed,
+};
+
+// Base point B, uncompressed with big-endian coordinates.
+static const uint8_t ed25519_base[65] = {
+  0x04,
+  0x21, 0x69, 0x36, 0xd3, 0xcd, 0x6e, 0x53, 0xfe, 0xc0, 0xa4, 0xe2, 0x31, 0xfd, 0xd6, 0xdc, 0x5c,
+  0x69, 0x2c, 0xc7, 0x60, 0x95, 0x25, 0xa7, 0xb2, 0xc9, 0x56, 0x2d, 0x60, 0x8f, 0x25, 0xd5, 0x1a,
+  0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+  0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x58,
+};
+
+// reduce_hash turns a little-endian SHA512 output into a big-endian
+// scalar modulo L.
+static void
+reduce_hash(const uint8_t *hash, uint8_t *scalar)
+{
+  uint8_t v[64];
+
+  for (int i = 0; i < 64; i++) {
+    v[i] = hash[63-i];
+  }
+
+  cx_math_modm(v, sizeof(v), ed25519_order, sizeof(ed25519_order));
+  os_memmove(scalar, &v[32], 32);
+  os_memset(v, 0, sizeof(v));
+}
+
+// expand_key derives the account key and expands it as RFC 8032 does
+// for the seed held by cx_ecfp_private_key_t: the first half of the
+// SHA512 is the clamped secret scalar, the second half the nonce prefix.
+static void
+expand_key(uint32_t accountId, uint8_t *h)
+{
+  cx_ecfp_private_key_t privateKey;
+  signing_key_get(accountId, &privateKey);
+  cx_hash_sha512(privateKey.d, 32, h, 64);
+  os_memset(&privateKey, 0, sizeof(privateKey));
+
+  h[0] &= 0xf8;
+  h[31] &= 0x7f;
+  h[31] |= 0x40;
+}
+
+void
+eddsa_stream_init(eddsa_stream_t *s, uint32_t accountId)
+{
+  uint8_t h[64];
+
+  os_memset(s, 0, sizeof(*s));
+  s->accountId = accountId;
+  expand_key(accountId, h);
+
+  cx_sha512_init(&s->hash);
+  cx_hash(&s->hash.header, 0, &h[32], 32, NULL, 0);
+  os_memset(h, 0, sizeof(h));
+}
+
+void
+eddsa_stream_update(eddsa_stream_t *s, const uint8_t *buf, size_t len)
+{
+  cx_hash(&s->hash.header, 0, buf, len, NULL, 0);
+}
+
+void
+eddsa_stream_commit(eddsa_stream_t *s)
+{
+  uint8_t h[64];
+  uint8_t P[65];
+
+  cx_hash(&s->hash.header, CX_LAST, NULL, 0, h, sizeof(h));
+  reduce_hash(h, s->r);
+  os_memset(h, 0, sizeof(h));
+
+  io_seproxyhal_io_heartbeat();
+
+  os_memmove(P, ed25519_base, sizeof(P));
+  cx_ecfp_scalar_mult(CX_CURVE_Ed25519, P, sizeof(P), s->r, sizeof(s->r));
+  cx_edward_compress_point(CX_CURVE_Ed25519, P, sizeof(P));
+  os_memmove(s->R, &P[1], sizeof(s->R));
+
+  io_seproxyhal_io_heartbeat();
+}
+
+void
+eddsa_stream_second_pass(eddsa_stream_t *s)
+{
+  uint8_t publicKey[32];
+  fetch_public_key(s->accountId, publicKey);
+
+  cx_sha512_init(&s->hash);
+  cx_hash(&s->hash.header, 0, s->R, sizeof(s->R), NULL, 0);
+  cx_hash(&s->hash.header, 0, publicKey, 32, NULL, 0);
+}
+
+void
+eddsa_stream_sign(eddsa_stream_t *s, uint8_t *sig)
+{
+  uint8_t h[64];
+  uint8_t k[32];
+  uint8_t a[32];
+  uint8_t S[32];
+
+  cx_hash(&s->hash.header, CX_LAST, NULL, 0, h, sizeof(h));
+  reduce_hash(h, k);
+
+  expand_key(s->accountId, h);
+  for (int i = 0; i < 32; i++) {
+    a[i] = h[31-i];
+  }
+  cx_math_modm(a, sizeof(a), ed25519_order, sizeof(ed25519_order));
+
+  // S = r + k*a mod L
+  cx_math_multm(S, k, a, ed25519_order, sizeof(S));
+  cx_math_addm(k, S, s->r, ed25519_order, sizeof(k));
+
+  os_memmove(sig, s->R, 32);
+  for (int i = 0; i < 32; i++) {
+    sig[32+i] = k[31-i];
+  }
+
+  os_memset(h, 0, sizeof(h));
+  os_memset(k, 0, sizeof(k));
+  os_memset(a, 0, sizeof(a));
+  os_memset(S, 0, sizeof(S));
+  eddsa_stream_clear(s);
+}
+
+void
+eddsa_stream_clear(eddsa_stream_t *s)
+{
+  os_memset(s, 0, sizeof(*s));
+}
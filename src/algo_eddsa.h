@@ -0,0 +1,31 @@
+#include "cx.h"
+
+// eddsa_stream_t computes an Ed25519 signature over a message that is
+// fed twice, instead of being held in memory: once to derive the nonce
+// r = H(prefix || M), and once more for k = H(R || A || M).
+typedef struct {
+  uint32_t accountId;
+  cx_sha512_t hash;
+  uint8_t r[32];  // nonce scalar, big-endian
+  uint8_t R[32];  // encoded nonce point
+} eddsa_stream_t;
+
+// First pass: derive the account key and start hashing the message.
+void eddsa_stream_init(eddsa_stream_t *s, uint32_t accountId);
+
+// Feed the next part of the message, in either pass.
+void eddsa_stream_update(eddsa_stream_t *s, const uint8_t *buf, size_t len);
+
+// End of the first pass: fix the nonce r and the point R = rB.
+void eddsa_stream_commit(eddsa_stream_t *s);
+
+// Start (or restart) the second pass.
+void eddsa_stream_second_pass(eddsa_stream_t *s);
+
+// End of the second pass: write the 64-byte signature R || S, and
+// wipe the state.  The caller must have checked that both passes fed
+// the same message.
+void eddsa_stream_sign(eddsa_stream_t *s, uint8_t *sig);
+
+// Wipe the state without signing.
+void eddsa_stream_clear(eddsa_stream_t *s);
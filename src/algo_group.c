@@ -0,0 +1,217 @@
+#include <string.h>
+#include "os.h"
+#include "cx.h"
+
+#include "algo_tx.h"
+#include "algo_group.h"
+#include "algo_addr.h"
+#include "msgpack.h"
+
+// The "grp" entry of a canonical encoding: the key, then a bin8 header
+// and the 32-byte group ID.
+#define GRP_ENTRY_LEN (1 + 3 + 2 + 32)
+
+static void
+hash_update(cx_sha512_t *h, const uint8_t *buf, size_t len)
+{
+  cx_hash(&h->header, 0, buf, len, NULL, 0);
+}
+
+// member_group_txid computes the ID of a member as its group commits
+// to it: that of the same transaction without the "grp" entry.
+static void
+member_group_txid(const uint8_t *enc, size_t len, uint16_t grp_off, uint8_t *txid)
+{
+  cx_sha512_t h;
+  uint8_t hdr[3];
+  size_t hdrlen;
+  size_t skip;
+  uint16_t count;
+  uint8_t hash[64];
+
+  if (enc[0] == MAP16) {
+    count = (enc[1] << 8) | enc[2];
+    skip = 3;
+  } else {
+    count = enc[0] - FIXMAP_0;
+    skip = 1;
+  }
+
+  // One entry less may also make the header shorter.
+  count--;
+  if (count <= FIXMAP_15 - FIXMAP_0) {
+    hdr[0] = FIXMAP_0 + count;
+    hdrlen = 1;
+  } else {
+    hdr[0] = MAP16;
+    hdr[1] = count >> 8;
+    hdr[2] = count & 0xff;
+    hdrlen = 3;
+  }
+
+  sha512_256_init(&h);
+  hash_update(&h, (uint8_t *) "TX", 2);
+  hash_update(&h, hdr, hdrlen);
+  hash_update(&h, enc + skip, grp_off - skip);
+  hash_update(&h, enc + grp_off + GRP_ENTRY_LEN, len - grp_off - GRP_ENTRY_LEN);
+  cx_hash(&h.header, CX_LAST, NULL, 0, hash, sizeof(hash));
+  os_memmove(txid, hash, 32);
+}
+
+static int
+add_u64(uint64_t *sum, uint64_t v)
+{
+  if (*sum + v < *sum) {
+    return 0;
+  }
+
+  *sum += v;
+  return 1;
+}
+
+static int
+all_zero(const uint8_t *buf, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] != 0) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int
+group_start(group_t *g, uint8_t size)
+{
+  // The group ID is the ID of the encoded {"txlist": [txid, ...]}.
+  static const uint8_t txlist[] = { FIXMAP_0 + 1, FIXSTR_0 + 6, 't', 'x', 'l', 'i', 's', 't' };
+
+  os_memset(g, 0, sizeof(*g));
+  if (size < 2 || size > GROUP_MAX_SIZE) {
+    return 0;
+  }
+
+  g->size = size;
+  sha512_256_init(&g->hash);
+  hash_update(&g->hash, (uint8_t *) "TG", 2);
+  hash_update(&g->hash, txlist, sizeof(txlist));
+
+  if (size <= FIXARR_15 - FIXARR_0) {
+    uint8_t hdr = FIXARR_0 + size;
+    hash_update(&g->hash, &hdr, 1);
+  } else {
+    uint8_t hdr[3] = { ARR16, 0, size };
+    hash_update(&g->hash, hdr, sizeof(hdr));
+  }
+
+  return 1;
+}
+
+int
+group_add(group_t *g, const txn_t *t, const uint8_t *enc, size_t len,
+          uint16_t grp_off, const uint8_t *txid, int sign)
+{
+  static const uint8_t bin32[] = { BIN8, 32 };
+  group_member_t *m;
+  uint8_t group_txid[32];
+
+  if (g->count == g->size || grp_off == 0) {
+    return 0;
+  }
+
+  if (g->count == 0) {
+    os_memmove(g->group_id, t->group, sizeof(g->group_id));
+  } else if (os_memcmp(g->group_id, t->group, sizeof(g->group_id)) != 0) {
+    return 0;
+  }
+
+  member_group_txid(enc, len, grp_off, group_txid);
+  hash_update(&g->hash, bin32, sizeof(bin32));
+  hash_update(&g->hash, group_txid, sizeof(group_txid));
+
+  m = &g->members[g->count++];
+  os_memmove(m->txid, txid, sizeof(m->txid));
+  m->type = t->type;
+  m->accountId = t->accountId;
+
+  switch (t->type) {
+  case PAYMENT:
+    os_memmove(m->receiver, t->payment.receiver, sizeof(m->receiver));
+    m->amount = t->payment.amount;
+    if (!all_zero(t->payment.close, sizeof(t->payment.close))) {
+      m->flags |= GROUP_CLOSE;
+    }
+    break;
+
+  case ASSET_XFER:
+    os_memmove(m->receiver, t->asset_xfer.receiver, sizeof(m->receiver));
+    m->amount = t->asset_xfer.amount;
+    m->id = t->asset_xfer.id;
+    if (!all_zero(t->asset_xfer.close, sizeof(t->asset_xfer.close))) {
+      m->flags |= GROUP_CLOSE;
+    }
+    break;
+
+  case ASSET_FREEZE:
+    m->id = t->asset_freeze.id;
+    break;
+
+  case ASSET_CONFIG:
+    m->id = t->asset_config.id;
+    break;
+
+  case APPLICATION:
+    m->id = t->application.id;
+    break;
+
+  default:
+    break;
+  }
+
+  if (!all_zero(t->rekey, sizeof(t->rekey))) {
+    m->flags |= GROUP_REKEY;
+  }
+
+  if (sign) {
+    m->flags |= GROUP_SIGN;
+    if (!add_u64(&g->fees, t->fee)) {
+      return 0;
+    }
+    if (t->type == PAYMENT && !add_u64(&g->amount, t->payment.amount)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+int
+group_finish(group_t *g)
+{
+  uint8_t hash[64];
+
+  if (g->count != g->size) {
+    return 0;
+  }
+
+  cx_hash(&g->hash.header, CX_LAST, NULL, 0, hash, sizeof(hash));
+  return os_memcmp(hash, g->group_id, sizeof(g->group_id)) == 0;
+}
+
+const group_member_t *
+group_member_to_sign(const group_t *g, uint8_t index, const uint8_t *txid)
+{
+  const group_member_t *m;
+
+  if (index >= g->count) {
+    return NULL;
+  }
+
+  m = &g->members[index];
+  if (!(m->flags & GROUP_SIGN) || os_memcmp(m->txid, txid, sizeof(m->txid)) != 0) {
+    return NULL;
+  }
+
+  return m;
+}
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "cx.h"
+
+// Include after algo_tx.h.
+
+// An atomic group is reviewed once as a whole, so the device keeps a
+// summary of each member rather than the members themselves.
+#if defined(TARGET_NANOX)
+#define GROUP_MAX_SIZE 16
+#else
+#define GROUP_MAX_SIZE 4
+#endif
+
+// Group member flags
+#define GROUP_SIGN    0x01      // signed by the device, with accountId
+#define GROUP_CLOSE   0x02      // closes the sender's account or holding
+#define GROUP_REKEY   0x04      // rekeys the sender's account
+
+typedef struct {
+  uint8_t txid[32];         // ID of the member as received, for signing
+  uint8_t receiver[32];     // payment or asset receiver, if any
+  uint64_t amount;          // payment or asset amount
+  uint64_t id;              // asset or application ID, if any
+  uint32_t accountId;
+  uint8_t type;
+  uint8_t flags;
+} group_member_t;
+
+typedef struct {
+  uint8_t size;
+  uint8_t count;            // members received so far
+  uint8_t group_id[32];     // the members' "grp"
+  uint64_t fees;            // total fee of the members to sign
+  uint64_t amount;          // total Algos paid by the members to sign
+  cx_sha512_t hash;         // group ID over the members received so far
+  group_member_t members[GROUP_MAX_SIZE];
+} group_t;
+
+// group_start begins a group of size members.  It returns 0 if the
+// device cannot hold that many.
+int group_start(group_t *g, uint8_t size);
+
+// group_add adds the next member, decoded from enc into t, where the
+// decoder found its "grp" key at grp_off, and whose ID is txid.  With
+// sign set, the member is signed by t->accountId once the group is
+// approved.  It returns 0 if the member does not belong to the group.
+int group_add(group_t *g, const txn_t *t, const uint8_t *enc, size_t len,
+              uint16_t grp_off, const uint8_t *txid, int sign);
+
+// group_finish checks, once every member was added, that the members'
+// "grp" is the ID of the group they make up.
+int group_finish(group_t *g);
+
+// group_member_to_sign returns the member at index if it is to be
+// signed and its ID is txid, or NULL.
+const group_member_t *group_member_to_sign(const group_t *g, uint8_t index, const uint8_t *txid);
+
+// Review the group on screen; group_approve is called once the user
+// accepts it.
+void ui_group(const group_t *g);
+void group_approve();
@@ -3,6 +3,7 @@
 #include "os_io_seproxyhal.h"
 
 #include "algo_keys.h"
+#include "algo_addr.h"
 
 
 void
@@ -52,16 +53,239 @@ algorand_public_key(const cx_ecfp_private_key_t *privateKey, uint8_t *buf)
   return 32;
 }
 
+/* A signing session ends after a minute without signatures, at 100 ms
+ * per ticker event.
+ */
+#define SIGNING_KEY_IDLE_TICKS 600
+
+static struct {
+  bool open;
+  bool valid;
+  uint32_t accountId;
+  uint16_t idle_ticks;
+  cx_ecfp_private_key_t key;
+} signing_key;
+
+void
+signing_key_end(void)
+{
+  memset(&signing_key, 0, sizeof(signing_key));
+}
+
+void
+signing_key_session(bool open)
+{
+  signing_key_end();
+  signing_key.open = open;
+}
+
+void
+signing_key_tick(void)
+{
+  if (signing_key.open && ++signing_key.idle_ticks >= SIGNING_KEY_IDLE_TICKS) {
+    signing_key_end();
+  }
+}
+
+void
+signing_key_get(uint32_t accountId, cx_ecfp_private_key_t *privateKey)
+{
+  if (!signing_key.open) {
+    algorand_key_derive(accountId, privateKey);
+    return;
+  }
+
+  // Only one account's key is ever held.
+  if (!signing_key.valid || signing_key.accountId != accountId) {
+    memset(&signing_key.key, 0, sizeof(signing_key.key));
+    algorand_key_derive(accountId, &signing_key.key);
+    signing_key.accountId = accountId;
+    signing_key.valid = true;
+  }
+
+  signing_key.idle_ticks = 0;
+  memcpy(privateKey, &signing_key.key, sizeof(*privateKey));
+}
+
+/* Most recently used first. */
+static already_computed_key_t pubkey_cache[PUBKEY_CACHE_SIZE];
+
+/* The cache is kept in NVRAM too, so that the app starts and switches
+ * to a recent account without deriving keys.  The seed cookie tells
+ * whether the keys were derived from the current seed: a passphrase
+ * PIN changes the seed without wiping the app.
+ */
+#define SEED_COOKIE_LEN 64
+
+typedef struct {
+  uint8_t seed_cookie[SEED_COOKIE_LEN];
+  already_computed_key_t keys[PUBKEY_CACHE_SIZE];
+} pubkey_storage_t;
+
+const pubkey_storage_t N_pubkeys_real;
+#define N_pubkeys (*(volatile pubkey_storage_t *) PIC(&N_pubkeys_real))
+
+/* Flash wears out, so the cache is not written back as it changes:
+ * a host scanning accounts would write it once per account.  It is
+ * written by pubkey_cache_save(), if it gained a newly derived key,
+ * so a scan costs one write however many keys it derived.
+ */
+static bool pubkey_cache_dirty;
+
+static void
+pubkey_cache_store(void)
+{
+  nvm_write((void *) N_pubkeys.keys, pubkey_cache, sizeof(pubkey_cache));
+  pubkey_cache_dirty = false;
+}
+
+void
+pubkey_cache_save(void)
+{
+  if (pubkey_cache_dirty) {
+    pubkey_cache_store();
+  }
+}
+
+static int
+pubkey_cache_find(uint32_t accountId)
+{
+  for (int i = 0; i < PUBKEY_CACHE_SIZE; i++) {
+    if (pubkey_cache[i].initialized && pubkey_cache[i].accountID == accountId) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/* Move the key of accountId to the front, evicting the least
+ * recently used key if it was not cached.
+ */
+static void
+pubkey_cache_put(uint32_t accountId, const uint8_t *pubkey)
+{
+  already_computed_key_t key;
+  int i = pubkey_cache_find(accountId);
+
+  if (i < 0) {
+    i = PUBKEY_CACHE_SIZE - 1;
+    key.initialized = true;
+    key.accountID = accountId;
+    memcpy(key.pubkey, pubkey, sizeof(key.pubkey));
+    addr_checksum(pubkey, key.checksum);
+    pubkey_cache_dirty = true;
+  } else {
+    key = pubkey_cache[i];
+  }
+
+  memmove(&pubkey_cache[1], &pubkey_cache[0], i * sizeof(pubkey_cache[0]));
+  pubkey_cache[0] = key;
+}
+
+static void
+pubkey_cache_clear(void)
+{
+  memset(pubkey_cache, 0, sizeof(pubkey_cache));
+}
+
+void
+pubkey_cache_load(void)
+{
+  static bool loaded;
+  uint8_t cookie[SEED_COOKIE_LEN];
+
+  // Once per launch: after a transport reset, the cache in RAM may
+  // hold keys not written back yet.
+  if (loaded) {
+    return;
+  }
+  loaded = true;
+
+  os_perso_seed_cookie(cookie, sizeof(cookie));
+  if (memcmp(cookie, (const void *) N_pubkeys.seed_cookie, sizeof(cookie)) == 0) {
+    memcpy(pubkey_cache, (const void *) N_pubkeys.keys, sizeof(pubkey_cache));
+    return;
+  }
+
+  // Another seed: forget the keys of the previous one.
+  pubkey_cache_clear();
+  pubkey_cache_store();
+  nvm_write((void *) N_pubkeys.seed_cookie, cookie, sizeof(cookie));
+}
+
+static void
+derive_public_key(uint32_t accountId, uint8_t *pubkey)
+{
+  cx_ecfp_private_key_t privateKey;
+  algorand_key_derive(accountId, &privateKey);
+  algorand_public_key(&privateKey, pubkey);
+  memset(&privateKey, 0, sizeof(privateKey));
+}
+
 size_t fetch_public_key(uint32_t accountId, uint8_t* pubkey){
-  if(!current_pubkey.initialized ||
-     current_pubkey.accountID != accountId){
-    cx_ecfp_private_key_t privateKey;
-    algorand_key_derive(accountId, &privateKey);
-    algorand_public_key(&privateKey, current_pubkey.pubkey);
-    memset(&privateKey, 0, sizeof(privateKey));
-    current_pubkey.accountID = accountId;
-    current_pubkey.initialized = true;
+  int i = pubkey_cache_find(accountId);
+  if (i < 0) {
+    derive_public_key(accountId, pubkey);
+    pubkey_cache_put(accountId, pubkey);
+  } else {
+    memcpy(pubkey, pubkey_cache[i].pubkey, sizeof(pubkey_cache[i].pubkey));
+    pubkey_cache_put(accountId, pubkey);
   }
-  memcpy(pubkey, current_pubkey.pubkey, sizeof(current_pubkey.pubkey));
-  return sizeof(current_pubkey.pubkey);
-}
\ No newline at end of file
+  return sizeof(pubkey_cache[0].pubkey);
+}
+
+void
+fetch_address(uint32_t accountId, char *out)
+{
+  uint8_t pubkey[32];
+
+  // The key of accountId is now first in the cache.
+  fetch_public_key(accountId, pubkey);
+  addr_encode(pubkey, pubkey_cache[0].checksum, out);
+}
+
+void
+fetch_public_keys(uint32_t first, uint8_t count, uint8_t *pubkeys)
+{
+  for (uint8_t n = 0; n < count; n++, pubkeys += 32) {
+    int i = pubkey_cache_find(first + n);
+    if (i < 0) {
+      derive_public_key(first + n, pubkeys);
+    } else {
+      memcpy(pubkeys, pubkey_cache[i].pubkey, 32);
+    }
+  }
+}
+
+int
+find_account(const uint8_t *pubkey, uint32_t first, uint32_t count, uint32_t *accountId)
+{
+  uint8_t derived[32];
+
+  // The cached keys first, since they need no derivation.
+  for (int i = 0; i < PUBKEY_CACHE_SIZE; i++) {
+    if (pubkey_cache[i].initialized &&
+        pubkey_cache[i].accountID - first < count &&
+        memcmp(pubkey_cache[i].pubkey, pubkey, sizeof(pubkey_cache[i].pubkey)) == 0) {
+      *accountId = pubkey_cache[i].accountID;
+      pubkey_cache_put(*accountId, pubkey);
+      return 1;
+    }
+  }
+
+  for (uint32_t n = 0; n < count; n++) {
+    if (pubkey_cache_find(first + n) >= 0) {
+      continue;
+    }
+
+    derive_public_key(first + n, derived);
+    if (memcmp(derived, pubkey, sizeof(derived)) == 0) {
+      *accountId = first + n;
+      pubkey_cache_put(*accountId, pubkey);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -1,13 +1,57 @@
 #include "cx.h"
 #include "stdbool.h"
 
+// Public keys of the most recently used accounts are kept, in RAM and
+// NVRAM, with the checksum of their address, so that starting the app
+// and switching between a few accounts does not derive their keys or
+// hash their addresses again.
+#if defined(TARGET_NANOX)
+#define PUBKEY_CACHE_SIZE 8
+#else
+#define PUBKEY_CACHE_SIZE 4
+#endif
+
 typedef struct{
     bool initialized;
     uint32_t accountID;
     uint8_t pubkey[32];
+    uint8_t checksum[4];
 } already_computed_key_t;
 
-extern already_computed_key_t current_pubkey;
-
 void algorand_key_derive(uint32_t accountId, cx_ecfp_private_key_t *privateKey);
 size_t fetch_public_key(uint32_t accountId, uint8_t* pubkey);
+
+// Write the checksummed address of accountId to out, which must be at
+// least 65 bytes long.
+void fetch_address(uint32_t accountId, char *out);
+
+// Fill the cache with the keys kept in NVRAM, if they were derived from
+// the current seed.
+void pubkey_cache_load(void);
+
+// Write the cache back to NVRAM if it gained keys since it was last
+// written: once the startup key is known, after a request the user
+// makes for one account (showing its address, signing), and when the
+// app exits.  Scanning accounts only writes it then.
+void pubkey_cache_save(void);
+
+// Write the public keys of accounts first to first+count-1 to pubkeys,
+// 32 bytes each.  Keys derived here are not cached.
+void fetch_public_keys(uint32_t first, uint8_t count, uint8_t *pubkeys);
+
+// Look for the account in [first, first+count) whose public key is
+// pubkey.  It returns 1 and sets *accountId if found, 0 otherwise.
+int find_account(const uint8_t *pubkey, uint32_t first, uint32_t count, uint32_t *accountId);
+
+// While a signing session is open, the private key of the account that
+// signed last stays in RAM, so that back-to-back signatures skip the
+// derivation.  signing_key_get() writes the key of accountId, derived
+// or from the session; the caller wipes its copy after use.
+void signing_key_get(uint32_t accountId, cx_ecfp_private_key_t *privateKey);
+void signing_key_session(bool open);
+
+// Wipe the key and close the session.
+void signing_key_end(void);
+
+// Called on every ticker event, to end idle sessions.
+void signing_key_tick(void);
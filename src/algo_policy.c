@@ -0,0 +1,57 @@
+#include <string.h>
+#include "os.h"
+
+#include "algo_keys.h"
+#include "algo_tx.h"
+#include "algo_policy.h"
+
+static bool
+all_zero(const uint8_t *buf, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+policy_matches(const policy_t *p, const txn_t *t)
+{
+  uint8_t publicKey[32];
+
+  if (p->kind == POLICY_NONE ||
+      t->accountId != p->accountId ||
+      t->fee > p->max_fee ||
+      !all_zero(t->rekey, sizeof(t->rekey))) {
+    return false;
+  }
+
+  // Not a rekeyed account signing for another one.
+  fetch_public_key(t->accountId, publicKey);
+  if (os_memcmp(publicKey, t->sender, sizeof(publicKey)) != 0) {
+    return false;
+  }
+
+  switch (p->kind) {
+  case POLICY_KEYREG:
+    return t->type == KEYREG &&
+           !t->keyreg.nonpartFlag &&
+           !all_zero(t->keyreg.votepk, sizeof(t->keyreg.votepk)) &&
+           !all_zero(t->keyreg.vrfpk, sizeof(t->keyreg.vrfpk)) &&
+           t->keyreg.voteFirst >= p->vote_first &&
+           t->keyreg.voteLast <= p->vote_last &&
+           t->keyreg.voteFirst <= t->keyreg.voteLast;
+
+  case POLICY_PAYMENT:
+    return t->type == PAYMENT &&
+           os_memcmp(t->payment.receiver, p->receiver, sizeof(p->receiver)) == 0 &&
+           t->payment.amount <= p->max_amount &&
+           all_zero(t->payment.close, sizeof(t->payment.close));
+
+  default:
+    return false;
+  }
+}
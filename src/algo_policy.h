@@ -0,0 +1,32 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+// Include after algo_tx.h.
+
+// A signing policy, once approved on the device, lets transactions that
+// match it be signed without their own review, for repetitive
+// operations.
+#define POLICY_NONE     0
+#define POLICY_KEYREG   1       // key registrations
+#define POLICY_PAYMENT  2       // payments to one receiver
+
+typedef struct {
+  uint8_t kind;
+  uint32_t accountId;       // the only account that signs
+  uint64_t max_fee;
+  uint8_t receiver[32];     // payments only
+  uint64_t max_amount;      // payments only
+  uint64_t vote_first;      // key registrations only: the rounds the
+  uint64_t vote_last;       // registered keys may vote in
+} policy_t;
+
+// policy_matches tells whether t may be signed under p: sent by p's
+// account with its own key, within p's fee, and neither closing nor
+// rekeying the account. A key registration must register keys online
+// for rounds within p's vote rounds.
+bool policy_matches(const policy_t *p, const txn_t *t);
+
+// Review the policy on screen; policy_approve is called once the user
+// accepts it.
+void ui_policy(const policy_t *p);
+void policy_approve();
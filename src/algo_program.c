@@ -0,0 +1,74 @@
+#include <string.h>
+#include "os.h"
+
+#include "algo_program.h"
+
+typedef struct {
+  uint8_t hash[32];
+  uint32_t accountId;       // the only account that signs it
+} program_entry_t;
+
+typedef struct {
+  uint8_t next;                             // slot to write next
+  program_entry_t programs[PROGRAM_CACHE_SIZE];
+} program_storage_t;
+
+const program_storage_t N_programs_real;
+#define N_programs (*(volatile program_storage_t *) PIC(&N_programs_real))
+
+static bool
+all_zero(const volatile uint8_t *buf, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool
+program_is_remembered(const uint8_t *hash, uint32_t accountId)
+{
+  for (int i = 0; i < PROGRAM_CACHE_SIZE; i++) {
+    volatile program_entry_t *p = &N_programs.programs[i];
+
+    if (!all_zero(p->hash, sizeof(p->hash)) &&
+        memcmp((const void *) p->hash, hash, sizeof(p->hash)) == 0 &&
+        p->accountId == accountId) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+program_remember(const uint8_t *hash, uint32_t accountId)
+{
+  program_entry_t entry;
+  uint8_t next;
+
+  if (program_is_remembered(hash, accountId)) {
+    return;
+  }
+
+  memcpy(entry.hash, hash, sizeof(entry.hash));
+  entry.accountId = accountId;
+
+  // The oldest program is forgotten first.
+  next = N_programs.next % PROGRAM_CACHE_SIZE;
+  nvm_write((void *) &N_programs.programs[next], &entry, sizeof(entry));
+  next = (next + 1) % PROGRAM_CACHE_SIZE;
+  nvm_write((void *) &N_programs.next, &next, sizeof(next));
+}
+
+void
+program_forget_all(void)
+{
+  program_storage_t empty;
+
+  memset(&empty, 0, sizeof(empty));
+  nvm_write((void *) &N_programs, &empty, sizeof(empty));
+}
@@ -0,0 +1,24 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+// Delegated LogicSigs sign "Program" || program, and the program's
+// SHA512/256 of the same bytes is its escrow address.  The hashes of
+// programs the user chose to remember are kept in NVRAM, each with the
+// account it was approved for, so that delegating one of them again
+// from that account needs no review.
+#define PROGRAM_CACHE_SIZE 8
+
+bool program_is_remembered(const uint8_t *hash, uint32_t accountId);
+void program_remember(const uint8_t *hash, uint32_t accountId);
+void program_forget_all(void);
+
+// Review the program of len bytes whose hash is hash, to be signed by
+// accountId; program_approve is called once the user accepts it,
+// remember telling whether to remember the program too.
+void ui_program(uint32_t len, const uint8_t *hash, uint32_t accountId);
+void program_approve(bool remember);
+
+// Ask the user to forget all remembered programs;
+// program_forget_approve is called once they accept.
+void ui_program_forget(void);
+void program_forget_approve(void);
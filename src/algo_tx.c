@@ -12,7 +12,8 @@ put_byte(uint8_t **p, uint8_t *e, uint8_t b)
   }
 }
 
-static void
+// encode_str returns 0 if the string is too long to encode, 1 otherwise.
+static int
 encode_str(uint8_t **p, uint8_t *e, const char *s, size_t maxlen)
 {
   int len = strnlen(s, maxlen);
@@ -21,7 +22,7 @@ encode_str(uint8_t **p, uint8_t *e, const char *s, size_t maxlen)
     for (int i = 0; i < len; i++) {
       put_byte(p, e, s[i]);
     }
-    return;
+    return 1;
   }
 
   if (len < (1 << 8)) {
@@ -30,11 +31,11 @@ encode_str(uint8_t **p, uint8_t *e, const char *s, size_t maxlen)
     for (int i = 0; i < len; i++) {
       put_byte(p, e, s[i]);
     }
-    return;
+    return 1;
   }
 
   // Longer strings not supported
-  os_sched_exit(0);
+  return 0;
 }
 
 static void
@@ -88,7 +89,8 @@ encode_bool(uint8_t **p, uint8_t *e, uint8_t v)
   }
 }
 
-static void
+// encode_bin returns 0 if the blob is too long to encode, 1 otherwise.
+static int
 encode_bin(uint8_t **p, uint8_t *e, uint8_t *bytes, int len)
 {
   if (len < (1 << 8)) {
@@ -100,183 +102,557 @@ encode_bin(uint8_t **p, uint8_t *e, uint8_t *bytes, int len)
     put_byte(p, e, len & 0xFF);
   } else {
     // Longer binary blobs not suppported
-    os_sched_exit(0);
+    return 0;
   }
 
   for (int i = 0; i < len; i++) {
     put_byte(p, e, bytes[i]);
   }
+  return 1;
 }
 
-static int
-map_kv_bool(uint8_t **p, uint8_t *e, char *key, uint8_t val)
+#define FIELD_DESC(id, key, kind, type, member, max)    \
+  [id] = { key, kind, type, offsetof(txn_t, member), sizeof(((txn_t *) 0)->member), max },
+
+const tx_field_t tx_fields[FIELD_COUNT] = {
+  TXN_FIELDS(FIELD_DESC)
+  APAR_FIELDS(FIELD_DESC)
+  APGS_FIELDS(FIELD_DESC)
+  APLS_FIELDS(FIELD_DESC)
+};
+
+#undef FIELD_DESC
+
+#define COMPACT_FIELD(id, field) [id] = field,
+
+const uint8_t tx_compact_fields[TX_COMPACT_ID_COUNT] = {
+  TX_COMPACT_FIELDS(COMPACT_FIELD)
+};
+
+#undef COMPACT_FIELD
+
+const tx_network_t tx_networks[TX_NETWORK_COUNT] = {
+  [TX_NETWORK_MAINNET] = { "mainnet-v1.0", {
+    0xc0, 0x61, 0xc4, 0xd8, 0xfc, 0x1d, 0xbd, 0xde, 0xd2, 0xd7, 0x60, 0x4b, 0xe4, 0x56, 0x8e, 0x3f,
+    0x6d, 0x04, 0x19, 0x87, 0xac, 0x37, 0xbd, 0xe4, 0xb6, 0x20, 0xb5, 0xab, 0x39, 0x24, 0x8a, 0xdf,
+  } },
+  [TX_NETWORK_TESTNET] = { "testnet-v1.0", {
+    0x48, 0x63, 0xb5, 0x18, 0xa4, 0xb3, 0xc8, 0x4e, 0xc8, 0x10, 0xf2, 0x2d, 0x4f, 0x10, 0x81, 0xcb,
+    0x0f, 0x71, 0xf0, 0x59, 0xa7, 0xac, 0x20, 0xde, 0xc6, 0x2f, 0x7f, 0x70, 0xe5, 0x09, 0x3a, 0x22,
+  } },
+  [TX_NETWORK_BETANET] = { "betanet-v1.0", {
+    0x98, 0x58, 0x1a, 0xcc, 0x5f, 0xb6, 0xb9, 0x14, 0xb5, 0xb4, 0xc8, 0x8b, 0xf5, 0xdb, 0x23, 0xd3,
+    0x58, 0x49, 0x1b, 0x24, 0x84, 0x98, 0xf3, 0x76, 0xf0, 0x1f, 0xd3, 0x8e, 0x3b, 0xe9, 0x55, 0x6d,
+  } },
+};
+
+void
+tx_map_fields(uint8_t field, uint8_t *first, uint8_t *end)
 {
-  if (val == 0) {
-    return 0;
+  switch (field) {
+  case FIELD_APAR:
+    *first = FIELD_APAR_FIRST;
+    *end = FIELD_APGS_FIRST;
+    break;
+
+  case FIELD_APGS:
+    *first = FIELD_APGS_FIRST;
+    *end = FIELD_APLS_FIRST;
+    break;
+
+  case FIELD_APLS:
+    *first = FIELD_APLS_FIRST;
+    *end = FIELD_COUNT;
+    break;
+
+  default:
+    *first = 0;
+    *end = FIELD_APAR_FIRST;
   }
+}
 
-  encode_str(p, e, key, SIZE_MAX);
-  encode_bool(p, e, val);
-  return 1;
+const uint8_t *
+tx_view(const txn_t *t, tx_view_t v)
+{
+  return t->view_base + v.off;
+}
+
+static const char *
+tx_type_str(enum TXTYPE type)
+{
+  switch (type) {
+  case PAYMENT:
+    return "pay";
+
+  case KEYREG:
+    return "keyreg";
+
+  case ASSET_XFER:
+    return "axfer";
+
+  case ASSET_FREEZE:
+    return "afrz";
+
+  case ASSET_CONFIG:
+    return "acfg";
+
+  case APPLICATION:
+    return "appl";
+
+  default:
+    PRINTF("Unknown transaction type %d\n", type);
+    return "unknown";
+  }
 }
 
 static int
-map_kv_uint64(uint8_t **p, uint8_t *e, char *key, uint64_t val)
+all_zero(const uint8_t *buf, size_t len)
 {
-  if (val == 0) {
-    return 0;
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] != 0) {
+      return 0;
+    }
   }
 
-  encode_str(p, e, key, SIZE_MAX);
-  encode_uint64(p, e, val);
   return 1;
 }
 
+static int encode_fields(uint8_t **p, uint8_t *e, txn_t *t, int first, int end);
+
+// encode_map appends a map of the fields in [first, end), and returns
+// how many it holds, or -1 if one of them cannot be encoded.
 static int
-map_kv_str(uint8_t **p, uint8_t *e, char *key, char *val, size_t maxlen)
+encode_map(uint8_t **p, uint8_t *e, txn_t *t, int first, int end)
 {
-  if (strnlen(val, maxlen) == 0) {
+  uint8_t *mapbase = *p;
+  if (*p >= e) {
+    // We need to access mapbase[0] below, so if there isn't space for
+    // at least one byte, bail out.
     return 0;
   }
 
-  encode_str(p, e, key, SIZE_MAX);
-  encode_str(p, e, val, maxlen);
-  return 1;
+  put_byte(p, e, FIXMAP_0);
+  int count = encode_fields(p, e, t, first, end);
+  if (count < 0) {
+    return -1;
+  }
+
+  if (count <= FIXMAP_15 - FIXMAP_0) {
+    mapbase[0] += count;
+    return count;
+  }
+
+  // Too many keys for a fixmap: make room for a MAP16 header.
+  if (e - *p < 2) {
+    *p = e;
+    return count;
+  }
+
+  os_memmove(mapbase + 3, mapbase + 1, *p - (mapbase + 1));
+  mapbase[0] = MAP16;
+  mapbase[1] = count >> 8;
+  mapbase[2] = count & 0xff;
+  *p += 2;
+  return count;
 }
 
+// encode_fields appends the non-zero fields in [first, end) of the
+// schema that apply to t's type, in table (that is, sorted key) order,
+// and returns how many it appended, or -1 if one of them cannot be
+// encoded.
 static int
-map_kv_bin(uint8_t **p, uint8_t *e, char *key, uint8_t *valbuf, int vallen)
+encode_fields(uint8_t **p, uint8_t *e, txn_t *t, int first, int end)
 {
-  int allzero = 1;
+  int count = 0;
+
+  for (int i = first; i < end; i++) {
+    const tx_field_t *f = &tx_fields[i];
+    uint8_t *val = (uint8_t *) t + f->offset;
+    uint8_t *psave = *p;
+
+    if (f->type != ALL_TYPES && f->type != t->type) {
+      continue;
+    }
+
+    switch (f->kind) {
+    case KIND_UINT64:
+      if (*(uint64_t *) val == 0) {
+        continue;
+      }
+      encode_str(p, e, f->key, sizeof(f->key));
+      encode_uint64(p, e, *(uint64_t *) val);
+      break;
+
+    case KIND_BOOL:
+      if (*val == 0) {
+        continue;
+      }
+      encode_str(p, e, f->key, sizeof(f->key));
+      encode_bool(p, e, *val);
+      break;
+
+    case KIND_STR: {
+      tx_view_t *v = (tx_view_t *) val;
+      if (v->len == 0) {
+        continue;
+      }
+      encode_str(p, e, f->key, sizeof(f->key));
+      if (!encode_str(p, e, (const char *) tx_view(t, *v), v->len)) {
+        return -1;
+      }
+      break;
+    }
 
-  for (int i = 0; i < vallen; i++) {
-    if (valbuf[i] != 0) {
-      allzero = 0;
+    case KIND_BIN_FIXED:
+      if (all_zero(val, f->size)) {
+        continue;
+      }
+      encode_str(p, e, f->key, sizeof(f->key));
+      if (!encode_bin(p, e, val, f->size)) {
+        return -1;
+      }
+      break;
+
+    case KIND_BIN_DIGEST:
+      // The note is the only digested field.  Only a note that fits
+      // in its preview can be encoded again.
+      if (t->note_len == 0) {
+        continue;
+      }
+      if (t->note_len > f->size) {
+        return -1;
+      }
+      encode_str(p, e, f->key, sizeof(f->key));
+      encode_bin(p, e, val, t->note_len);
+      break;
+
+    case KIND_BIN_HASH:
+    case KIND_ARR_BIN:
+    case KIND_ARR_ADDR:
+    case KIND_ARR_UINT:
+      // Only the digest of these values is kept, so they cannot be
+      // encoded again.
+      if (((tx_digest_t *) val)->len == 0) {
+        continue;
+      }
+      return -1;
+
+    case KIND_TYPE:
+      encode_str(p, e, f->key, sizeof(f->key));
+      encode_str(p, e, tx_type_str(t->type), SIZE_MAX);
+      break;
+
+    case KIND_MAP: {
+      uint8_t map_first, map_end;
+      int map_count;
+
+      encode_str(p, e, f->key, sizeof(f->key));
+      tx_map_fields(i, &map_first, &map_end);
+      map_count = encode_map(p, e, t, map_first, map_end);
+      if (map_count < 0) {
+        return -1;
+      }
+      if (map_count == 0) {
+        // No keys is a zero value; roll back any changes
+        *p = psave;
+        continue;
+      }
+      break;
     }
+    }
+
+    count++;
   }
 
-  if (allzero) {
+  return count;
+}
+
+unsigned int
+tx_encode(txn_t *t, uint8_t *buf, int buflen)
+{
+  uint8_t *p = buf;
+  uint8_t *e = &buf[buflen];
+
+  // Fill in the fields in sorted key order, counting the
+  // map elements as we go if they are non-zero.
+  // Type-specific fields are encoded only if the type matches.
+  if (encode_map(&p, e, t, 0, FIELD_APAR_FIRST) < 0) {
     return 0;
   }
 
-  encode_str(p, e, key, SIZE_MAX);
-  encode_bin(p, e, valbuf, vallen);
-  return 1;
+  return p-buf;
 }
 
-static int
-map_kv_params(uint8_t **p, uint8_t *e, char *key, struct asset_params *params)
+// delta_field returns the transaction field whose key is the len
+// bytes at key, or FIELD_COUNT if there is none.
+static uint8_t
+delta_field(const uint8_t *key, size_t len)
 {
-  // Save original buffer in case we end up with a zero value
-  uint8_t *psave = *p;
-
-  encode_str(p, e, key, SIZE_MAX);
+  if (len > sizeof(tx_fields[0].key)) {
+    return FIELD_COUNT;
+  }
 
-  uint8_t *mapbase = *p;
-  if (*p >= e) {
-    // We need to access mapbase[0] below, so if there isn't space for at least
-    // one byte, bail out.
-    return 0;
+  for (uint8_t i = 0; i < FIELD_APAR_FIRST; i++) {
+    if (strnlen(tx_fields[i].key, sizeof(tx_fields[i].key)) == len &&
+        memcmp(tx_fields[i].key, key, len) == 0) {
+      return i;
+    }
   }
 
-  put_byte(p, e, FIXMAP_0);
+  return FIELD_COUNT;
+}
 
-  mapbase[0] += map_kv_bin   (p, e, "am", params->metadata_hash, sizeof(params->metadata_hash));
-  mapbase[0] += map_kv_str   (p, e, "an", params->assetname, sizeof(params->assetname));
-  mapbase[0] += map_kv_str   (p, e, "au", params->url, sizeof(params->url));
-  mapbase[0] += map_kv_bin   (p, e, "c",  params->clawback, sizeof(params->clawback));
-  mapbase[0] += map_kv_uint64(p, e, "dc", params->decimals);
-  mapbase[0] += map_kv_bool  (p, e, "df", params->default_frozen);
-  mapbase[0] += map_kv_bin   (p, e, "f",  params->freeze, sizeof(params->freeze));
-  mapbase[0] += map_kv_bin   (p, e, "m",  params->manager, sizeof(params->manager));
-  mapbase[0] += map_kv_bin   (p, e, "r",  params->reserve, sizeof(params->reserve));
-  mapbase[0] += map_kv_uint64(p, e, "t",  params->total);
-  mapbase[0] += map_kv_str   (p, e, "un", params->unitname, sizeof(params->unitname));
-
-  if (mapbase[0] == FIXMAP_0) {
-    // No keys is a zero value; roll back any changes
-    *p = psave;
-    return 0;
+// can_encode tells whether tx_encode can encode t again, that is
+// whether t holds no value of which only a digest is kept.
+static int
+can_encode(const txn_t *t)
+{
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    const tx_field_t *f = &tx_fields[i];
+    const uint8_t *val = (const uint8_t *) t + f->offset;
+
+    if (f->type != ALL_TYPES && f->type != t->type) {
+      continue;
+    }
+    if (f->kind == KIND_BIN_DIGEST && t->note_len > f->size) {
+      return 0;
+    }
+    if ((f->kind == KIND_BIN_HASH || f->kind == KIND_ARR_BIN ||
+         f->kind == KIND_ARR_ADDR || f->kind == KIND_ARR_UINT) &&
+        ((const tx_digest_t *) val)->len != 0) {
+      return 0;
+    }
   }
 
   return 1;
 }
 
-unsigned int
-tx_encode(txn_t *t, uint8_t *buf, int buflen)
+int
+tx_apply_delta(txn_t *t, const uint8_t *delta, size_t len,
+               uint8_t *arena, size_t arena_size)
 {
-  char *typestr;
-  switch (t->type) {
-  case PAYMENT:
-    typestr = "pay";
-    break;
+  const uint8_t *e = delta + len;
+  size_t used = 0;
 
-  case KEYREG:
-    typestr = "keyreg";
-    break;
+  // Move the strings of t to the arena first, since the encoding
+  // they refer to is about to be replaced.
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    const tx_field_t *f = &tx_fields[i];
+    tx_view_t *v = (tx_view_t *) ((uint8_t *) t + f->offset);
 
-  case ASSET_XFER:
-    typestr = "axfer";
-    break;
+    if (f->kind != KIND_STR || (f->type != ALL_TYPES && f->type != t->type)) {
+      continue;
+    }
+    if (used + v->len > arena_size) {
+      return 0;
+    }
+    os_memmove(arena + used, tx_view(t, *v), v->len);
+    v->off = used;
+    used += v->len;
+  }
+  t->view_base = arena;
 
-  case ASSET_FREEZE:
-    typestr = "afrz";
-    break;
+  while (delta < e) {
+    // {key length} {key} {value length} {value}
+    if (e - delta < 2 || e - delta < 2 + delta[0]) {
+      return 0;
+    }
+    uint8_t field = delta_field(delta + 1, delta[0]);
+    delta += 1 + delta[0];
+    uint8_t vlen = *delta++;
+    if (e - delta < vlen || field == FIELD_COUNT) {
+      return 0;
+    }
 
-  case ASSET_CONFIG:
-    typestr = "acfg";
-    break;
+    const tx_field_t *f = &tx_fields[field];
+    uint8_t *val = (uint8_t *) t + f->offset;
+    if (f->type != ALL_TYPES && f->type != t->type) {
+      return 0;
+    }
 
-  default:
-    PRINTF("Unknown transaction type %d\n", t->type);
-    typestr = "unknown";
+    switch (f->kind) {
+    case KIND_UINT64:
+      if (vlen > sizeof(uint64_t)) {
+        return 0;
+      }
+      *(uint64_t *) val = 0;
+      for (int i = 0; i < vlen; i++) {
+        *(uint64_t *) val = (*(uint64_t *) val << 8) | delta[i];
+      }
+      break;
+
+    case KIND_BOOL:
+      if (vlen > 1) {
+        return 0;
+      }
+      *val = vlen == 1 && delta[0] != 0;
+      break;
+
+    case KIND_STR: {
+      tx_view_t *v = (tx_view_t *) val;
+      if (vlen > f->max || used + vlen > arena_size) {
+        return 0;
+      }
+      os_memmove(arena + used, delta, vlen);
+      v->off = used;
+      v->len = vlen;
+      used += vlen;
+      break;
+    }
+
+    case KIND_BIN_FIXED:
+      if (vlen != 0 && vlen != f->size) {
+        return 0;
+      }
+      os_memset(val, 0, f->size);
+      os_memmove(val, delta, vlen);
+      break;
+
+    case KIND_BIN_DIGEST:
+      // Only a note that fits in its preview can be encoded again.
+      if (vlen > f->size) {
+        return 0;
+      }
+      os_memset(val, 0, f->size);
+      os_memmove(val, delta, vlen);
+      t->note_len = vlen;
+      break;
+
+    default:
+      // The type, nested maps and digested values cannot be changed.
+      return 0;
+    }
+
+    delta += vlen;
   }
 
-  uint8_t *p = buf;
-  *(p++) = FIXMAP_0;
+  return can_encode(t);
+}
 
-  uint8_t *e = &buf[buflen];
+// get_varint reads a LEB128 varint at *p, before e, into *v.
+static int
+get_varint(const uint8_t **p, const uint8_t *e, uint64_t *v)
+{
+  *v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*p >= e) {
+      return 0;
+    }
+    uint8_t b = *(*p)++;
+    if (shift == 63 && b > 1) {
+      return 0;
+    }
+    *v |= (uint64_t) (b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return 1;
+    }
+  }
 
-#define T(expected, encoder)                        \
-  ({                                                \
-    int res = 0;                                    \
-    if (t->type == expected) { res = encoder; }     \
-    res;                                            \
-  })
+  return 0;
+}
 
-  // Fill in the fields in sorted key order, bumping the
-  // number of map elements as we go if they are non-zero.
-  // Type-specific fields are encoded only if the type matches.
-  buf[0] += T(ASSET_XFER,   map_kv_uint64(&p, e, "aamt",    t->asset_xfer.amount));
-  buf[0] += T(ASSET_XFER,   map_kv_bin   (&p, e, "aclose",  t->asset_xfer.close, sizeof(t->asset_xfer.close)));
-  buf[0] += T(ASSET_FREEZE, map_kv_bool  (&p, e, "afrz",    t->asset_freeze.flag));
-  buf[0] += T(PAYMENT,      map_kv_uint64(&p, e, "amt",     t->payment.amount));
-  buf[0] += T(ASSET_CONFIG, map_kv_params(&p, e, "apar",    &t->asset_config.params));
-  buf[0] += T(ASSET_XFER,   map_kv_bin   (&p, e, "arcv",    t->asset_xfer.receiver, sizeof(t->asset_xfer.receiver)));
-  buf[0] += T(ASSET_XFER,   map_kv_bin   (&p, e, "asnd",    t->asset_xfer.sender, sizeof(t->asset_xfer.sender)));
-  buf[0] += T(ASSET_CONFIG, map_kv_uint64(&p, e, "caid",    t->asset_config.id));
-  buf[0] += T(PAYMENT,      map_kv_bin   (&p, e, "close",   t->payment.close, sizeof(t->payment.close)));
-  buf[0] += T(ASSET_FREEZE, map_kv_bin   (&p, e, "fadd",    t->asset_freeze.account, sizeof(t->asset_freeze.account)));
-  buf[0] += T(ASSET_FREEZE, map_kv_uint64(&p, e, "faid",    t->asset_freeze.id));
-  buf[0] +=                 map_kv_uint64(&p, e, "fee",     t->fee);
-  buf[0] +=                 map_kv_uint64(&p, e, "fv",      t->firstValid);
-  buf[0] +=                 map_kv_str   (&p, e, "gen",     t->genesisID, sizeof(t->genesisID));
-  buf[0] +=                 map_kv_bin   (&p, e, "gh",      t->genesisHash, sizeof(t->genesisHash));
-  buf[0] +=                 map_kv_uint64(&p, e, "lv",      t->lastValid);
-  buf[0] += T(KEYREG,       map_kv_bool  (&p, e, "nonpart", t->keyreg.nonpartFlag));
-  buf[0] +=                 map_kv_bin   (&p, e, "note",    t->note, t->note_len);
-  buf[0] += T(PAYMENT,      map_kv_bin   (&p, e, "rcv",     t->payment.receiver, sizeof(t->payment.receiver)));
-  buf[0] +=                 map_kv_bin   (&p, e, "rekey",   t->rekey, sizeof(t->rekey));
-  buf[0] += T(KEYREG,       map_kv_bin   (&p, e, "selkey",  t->keyreg.vrfpk, sizeof(t->keyreg.vrfpk)));
-  buf[0] +=                 map_kv_bin   (&p, e, "snd",     t->sender, sizeof(t->sender));
-  buf[0] +=                 map_kv_str   (&p, e, "type",    typestr, SIZE_MAX);
-  buf[0] += T(KEYREG,       map_kv_uint64(&p, e, "votefst", t->keyreg.voteFirst));
-  buf[0] += T(KEYREG,       map_kv_uint64(&p, e, "votekd",  t->keyreg.keyDilution));
-  buf[0] += T(KEYREG,       map_kv_bin   (&p, e, "votekey", t->keyreg.votepk, sizeof(t->keyreg.votepk)));
-  buf[0] += T(KEYREG,       map_kv_uint64(&p, e, "votelst", t->keyreg.voteLast));
-  buf[0] += T(ASSET_XFER,   map_kv_uint64(&p, e, "xaid",    t->asset_xfer.id));
-
-#undef T
+int
+tx_decode_compact(txn_t *t, const uint8_t *buf, size_t len,
+                  uint8_t *arena, size_t arena_size)
+{
+  const uint8_t *p = buf, *e = buf + len;
+  const uint8_t *bitmap;
+  size_t used = 0;
 
-  return p-buf;
+  if (len < 2 + TX_COMPACT_BITMAP_LEN) {
+    return 0;
+  }
+  t->type = *p++;
+  if (t->type == UNKNOWN || t->type >= ALL_TYPES) {
+    return 0;
+  }
+  uint8_t network = *p++;
+  bitmap = p;
+  p += TX_COMPACT_BITMAP_LEN;
+  if (TX_COMPACT_ID_COUNT % 8 != 0 &&
+      (bitmap[TX_COMPACT_ID_COUNT / 8] >> (TX_COMPACT_ID_COUNT % 8)) != 0) {
+    return 0;
+  }
+  t->view_base = arena;
+
+  if (network != TX_NETWORK_NONE) {
+    if (network >= TX_NETWORK_COUNT) {
+      return 0;
+    }
+    const tx_network_t *n = &tx_networks[network];
+    size_t idlen = strnlen(n->id, sizeof(n->id));
+    if (idlen > arena_size) {
+      return 0;
+    }
+    os_memmove(arena, n->id, idlen);
+    t->genesisID.off = 0;
+    t->genesisID.len = idlen;
+    used = idlen;
+    os_memmove(t->genesisHash, n->hash, sizeof(t->genesisHash));
+  }
+
+  for (int id = 0; id < TX_COMPACT_ID_COUNT; id++) {
+    if ((bitmap[id / 8] & (1 << (id % 8))) == 0) {
+      continue;
+    }
+
+    uint8_t i = tx_compact_fields[id];
+    const tx_field_t *f = &tx_fields[i];
+    uint8_t *val = (uint8_t *) t + f->offset;
+
+    if (f->type != ALL_TYPES && f->type != t->type) {
+      return 0;
+    }
+    if (network != TX_NETWORK_NONE && (i == FIELD_GEN || i == FIELD_GH)) {
+      return 0;
+    }
+
+    switch (f->kind) {
+    case KIND_UINT64:
+      if (!get_varint(&p, e, (uint64_t *) val)) {
+        return 0;
+      }
+      break;
+
+    case KIND_BOOL:
+      *val = 1;
+      break;
+
+    case KIND_STR: {
+      tx_view_t *v = (tx_view_t *) val;
+      if (p >= e || e - p - 1 < p[0] || p[0] > f->max || used + p[0] > arena_size) {
+        return 0;
+      }
+      os_memmove(arena + used, p + 1, p[0]);
+      v->off = used;
+      v->len = p[0];
+      used += p[0];
+      p += 1 + p[0];
+      break;
+    }
+
+    case KIND_BIN_FIXED:
+      if (e - p < f->size) {
+        return 0;
+      }
+      os_memmove(val, p, f->size);
+      p += f->size;
+      break;
+
+    case KIND_BIN_DIGEST:
+      // Only a note that fits in its preview can be encoded again.
+      if (p >= e || e - p - 1 < p[0] || p[0] > f->size) {
+        return 0;
+      }
+      os_memmove(val, p + 1, p[0]);
+      t->note_len = p[0];
+      p += 1 + p[0];
+      break;
+
+    default:
+      return 0;
+    }
+  }
+
+  return p == e;
 }
@@ -1,4 +1,6 @@
 #include <stdint.h>
+#include <stddef.h>
+#include "cx.h"
 
 enum TXTYPE {
   UNKNOWN,
@@ -7,16 +9,24 @@ enum TXTYPE {
   ASSET_XFER,
   ASSET_FREEZE,
   ASSET_CONFIG,
+  APPLICATION,
   ALL_TYPES,
 };
 
+// tx_view_t refers to a variable-length value by its place in the
+// txn_t's view_base buffer, instead of holding a copy.
+typedef struct {
+  uint16_t off;
+  uint16_t len;
+} tx_view_t;
+
 struct asset_params {
   uint64_t total;
   uint64_t decimals;
   uint8_t default_frozen;
-  char unitname[8];
-  char assetname[32];
-  char url[32];
+  tx_view_t unitname;
+  tx_view_t assetname;
+  tx_view_t url;
   uint8_t metadata_hash[32];
   uint8_t manager[32];
   uint8_t reserve[32];
@@ -58,6 +68,44 @@ struct txn_asset_config {
   struct asset_params params;
 };
 
+// tx_digest_t keeps a variable-length value too big to hold on the
+// device: its length (or element count, for an array) and SHA512/256.
+// The digest of an array covers its elements one after the other:
+// integers as 8 bytes and byte strings as their 2-byte length followed
+// by their bytes, all big-endian.
+typedef struct {
+  uint16_t len;
+  uint8_t hash[32];
+} tx_digest_t;
+
+struct state_schema {
+  uint64_t num_uint;
+  uint64_t num_byteslice;
+};
+
+struct txn_application {
+  uint64_t id;
+  uint64_t oncompletion;
+  uint64_t extra_pages;
+  tx_digest_t args;
+  tx_digest_t accounts;
+  tx_digest_t foreign_apps;
+  tx_digest_t foreign_assets;
+  tx_digest_t aprog;
+  tx_digest_t cprog;
+  struct state_schema global_schema;
+  struct state_schema local_schema;
+};
+
+// Protocol limits on application calls.  APP_ARGS_MAX_LEN bounds the
+// total length of the arguments, not that of each one.
+#define APP_ARGS_MAX_LEN 2048
+#define APP_PROG_MAX_LEN (4 * 2048)
+
+// Protocol limit on the size of a transaction note.
+#define NOTE_MAX_LEN 1024
+#define NOTE_PREVIEW_LEN 32
+
 typedef struct{
   enum TXTYPE type;
   // Account Id asscociated with this transaction.
@@ -69,16 +117,19 @@ typedef struct{
   uint64_t fee;
   uint64_t firstValid;
   uint64_t lastValid;
-  char genesisID[32];
+  tx_view_t genesisID;
   uint8_t genesisHash[32];
+  uint8_t group[32];
+  uint8_t lease[32];
 
-#if defined(TARGET_NANOX)
-  uint8_t note[512];
-#else
-  uint8_t note[32];
-#endif
+  // The note is not kept in full, only its length, its first bytes
+  // and its SHA512/256; the signature covers the received bytes.
+  uint16_t note_len;
+  uint8_t note[NOTE_PREVIEW_LEN];
+  uint8_t note_hash[32];
 
-  size_t note_len;
+  // The buffer that tx_view_t fields refer to.
+  const uint8_t *view_base;
 
   // Fields for specific tx types
   union {
@@ -87,19 +138,373 @@ typedef struct{
     struct txn_asset_xfer asset_xfer;
     struct txn_asset_freeze asset_freeze;
     struct txn_asset_config asset_config;
+    struct txn_application application;
   };
 } txn_t;
 
+// How the value of a field is encoded and stored.
+enum FIELD_KIND {
+  KIND_UINT64,
+  KIND_BOOL,
+  KIND_STR,
+  KIND_BIN_FIXED,
+  KIND_BIN_DIGEST,          // variable-length, kept as a preview and digest
+  KIND_BIN_HASH,            // variable-length, kept as a tx_digest_t
+  KIND_ARR_BIN,             // array of byte strings, kept as a tx_digest_t
+  KIND_ARR_ADDR,            // array of addresses, kept as a tx_digest_t
+  KIND_ARR_UINT,            // array of integers, kept as a tx_digest_t
+  KIND_TYPE,
+  KIND_MAP,
+};
+
+// The transaction schema: every field that we know how to decode,
+// encode and review, listed once as
+//
+//   X(id, key, kind, owning tx type, txn_t member, max length)
+//
+// where the max length only applies to variable-length values, and
+// is the max element count for arrays.
+// Each list must stay in canonical (sorted) key order, since the
+// encoder emits fields in table order.  ALL_TYPES marks header fields.
+#define TXN_FIELDS(X)                                                                                       \
+  X(FIELD_AAMT,      "aamt",    KIND_UINT64,     ASSET_XFER,   asset_xfer.amount,                   0)      \
+  X(FIELD_ACLOSE,    "aclose",  KIND_BIN_FIXED,  ASSET_XFER,   asset_xfer.close,                    0)      \
+  X(FIELD_AFRZ,      "afrz",    KIND_BOOL,       ASSET_FREEZE, asset_freeze.flag,                   0)      \
+  X(FIELD_AMT,       "amt",     KIND_UINT64,     PAYMENT,      payment.amount,                      0)      \
+  X(FIELD_APAA,      "apaa",    KIND_ARR_BIN,    APPLICATION,  application.args,                    16)     \
+  X(FIELD_APAN,      "apan",    KIND_UINT64,     APPLICATION,  application.oncompletion,            0)      \
+  X(FIELD_APAP,      "apap",    KIND_BIN_HASH,   APPLICATION,  application.aprog,                   APP_PROG_MAX_LEN)\
+  X(FIELD_APAR,      "apar",    KIND_MAP,        ASSET_CONFIG, asset_config.params,                 0)      \
+  X(FIELD_APAS,      "apas",    KIND_ARR_UINT,   APPLICATION,  application.foreign_assets,          8)      \
+  X(FIELD_APAT,      "apat",    KIND_ARR_ADDR,   APPLICATION,  application.accounts,                4)      \
+  X(FIELD_APEP,      "apep",    KIND_UINT64,     APPLICATION,  application.extra_pages,             0)      \
+  X(FIELD_APFA,      "apfa",    KIND_ARR_UINT,   APPLICATION,  application.foreign_apps,            8)      \
+  X(FIELD_APGS,      "apgs",    KIND_MAP,        APPLICATION,  application.global_schema,           0)      \
+  X(FIELD_APID,      "apid",    KIND_UINT64,     APPLICATION,  application.id,                      0)      \
+  X(FIELD_APLS,      "apls",    KIND_MAP,        APPLICATION,  application.local_schema,            0)      \
+  X(FIELD_APSU,      "apsu",    KIND_BIN_HASH,   APPLICATION,  application.cprog,                   APP_PROG_MAX_LEN)\
+  X(FIELD_ARCV,      "arcv",    KIND_BIN_FIXED,  ASSET_XFER,   asset_xfer.receiver,                 0)      \
+  X(FIELD_ASND,      "asnd",    KIND_BIN_FIXED,  ASSET_XFER,   asset_xfer.sender,                   0)      \
+  X(FIELD_CAID,      "caid",    KIND_UINT64,     ASSET_CONFIG, asset_config.id,                     0)      \
+  X(FIELD_CLOSE,     "close",   KIND_BIN_FIXED,  PAYMENT,      payment.close,                       0)      \
+  X(FIELD_FADD,      "fadd",    KIND_BIN_FIXED,  ASSET_FREEZE, asset_freeze.account,                0)      \
+  X(FIELD_FAID,      "faid",    KIND_UINT64,     ASSET_FREEZE, asset_freeze.id,                     0)      \
+  X(FIELD_FEE,       "fee",     KIND_UINT64,     ALL_TYPES,    fee,                                 0)      \
+  X(FIELD_FV,        "fv",      KIND_UINT64,     ALL_TYPES,    firstValid,                          0)      \
+  X(FIELD_GEN,       "gen",     KIND_STR,        ALL_TYPES,    genesisID,                           32)     \
+  X(FIELD_GH,        "gh",      KIND_BIN_FIXED,  ALL_TYPES,    genesisHash,                         0)      \
+  X(FIELD_GRP,       "grp",     KIND_BIN_FIXED,  ALL_TYPES,    group,                               0)      \
+  X(FIELD_LV,        "lv",      KIND_UINT64,     ALL_TYPES,    lastValid,                           0)      \
+  X(FIELD_LX,        "lx",      KIND_BIN_FIXED,  ALL_TYPES,    lease,                               0)      \
+  X(FIELD_NONPART,   "nonpart", KIND_BOOL,       KEYREG,       keyreg.nonpartFlag,                  0)      \
+  X(FIELD_NOTE,      "note",    KIND_BIN_DIGEST, ALL_TYPES,    note,                                NOTE_MAX_LEN)\
+  X(FIELD_RCV,       "rcv",     KIND_BIN_FIXED,  PAYMENT,      payment.receiver,                    0)      \
+  X(FIELD_REKEY,     "rekey",   KIND_BIN_FIXED,  ALL_TYPES,    rekey,                               0)      \
+  X(FIELD_SELKEY,    "selkey",  KIND_BIN_FIXED,  KEYREG,       keyreg.vrfpk,                        0)      \
+  X(FIELD_SND,       "snd",     KIND_BIN_FIXED,  ALL_TYPES,    sender,                              0)      \
+  X(FIELD_TYPE,      "type",    KIND_TYPE,       ALL_TYPES,    type,                                0)      \
+  X(FIELD_VOTEFST,   "votefst", KIND_UINT64,     KEYREG,       keyreg.voteFirst,                    0)      \
+  X(FIELD_VOTEKD,    "votekd",  KIND_UINT64,     KEYREG,       keyreg.keyDilution,                  0)      \
+  X(FIELD_VOTEKEY,   "votekey", KIND_BIN_FIXED,  KEYREG,       keyreg.votepk,                       0)      \
+  X(FIELD_VOTELST,   "votelst", KIND_UINT64,     KEYREG,       keyreg.voteLast,                     0)      \
+  X(FIELD_XAID,      "xaid",    KIND_UINT64,     ASSET_XFER,   asset_xfer.id,                       0)
+
+// Fields of the asset parameters map, the value of "apar".
+#define APAR_FIELDS(X)                                                                                      \
+  X(FIELD_APAR_AM,   "am",      KIND_BIN_FIXED,  ASSET_CONFIG, asset_config.params.metadata_hash,   0)      \
+  X(FIELD_APAR_AN,   "an",      KIND_STR,        ASSET_CONFIG, asset_config.params.assetname,       32)     \
+  X(FIELD_APAR_AU,   "au",      KIND_STR,        ASSET_CONFIG, asset_config.params.url,             32)     \
+  X(FIELD_APAR_C,    "c",       KIND_BIN_FIXED,  ASSET_CONFIG, asset_config.params.clawback,        0)      \
+  X(FIELD_APAR_DC,   "dc",      KIND_UINT64,     ASSET_CONFIG, asset_config.params.decimals,        0)      \
+  X(FIELD_APAR_DF,   "df",      KIND_BOOL,       ASSET_CONFIG, asset_config.params.default_frozen,  0)      \
+  X(FIELD_APAR_F,    "f",       KIND_BIN_FIXED,  ASSET_CONFIG, asset_config.params.freeze,          0)      \
+  X(FIELD_APAR_M,    "m",       KIND_BIN_FIXED,  ASSET_CONFIG, asset_config.params.manager,         0)      \
+  X(FIELD_APAR_R,    "r",       KIND_BIN_FIXED,  ASSET_CONFIG, asset_config.params.reserve,         0)      \
+  X(FIELD_APAR_T,    "t",       KIND_UINT64,     ASSET_CONFIG, asset_config.params.total,           0)      \
+  X(FIELD_APAR_UN,   "un",      KIND_STR,        ASSET_CONFIG, asset_config.params.unitname,        8)
+
+// Fields of the state schema maps, the values of "apgs" and "apls".
+#define APGS_FIELDS(X)                                                                                      \
+  X(FIELD_APGS_NBS,  "nbs",     KIND_UINT64,     APPLICATION,  application.global_schema.num_byteslice, 0)   \
+  X(FIELD_APGS_NUI,  "nui",     KIND_UINT64,     APPLICATION,  application.global_schema.num_uint,      0)
+
+#define APLS_FIELDS(X)                                                                                      \
+  X(FIELD_APLS_NBS,  "nbs",     KIND_UINT64,     APPLICATION,  application.local_schema.num_byteslice,  0)   \
+  X(FIELD_APLS_NUI,  "nui",     KIND_UINT64,     APPLICATION,  application.local_schema.num_uint,       0)
+
+#define FIELD_ENUM(id, key, kind, type, member, max) id,
+enum TXFIELD {
+  TXN_FIELDS(FIELD_ENUM)
+  APAR_FIELDS(FIELD_ENUM)
+  APGS_FIELDS(FIELD_ENUM)
+  APLS_FIELDS(FIELD_ENUM)
+  FIELD_COUNT,
+};
+#undef FIELD_ENUM
+
+// Transaction fields come first in tx_fields[], then the fields of
+// each nested map, one map after the other.
+#define FIELD_APAR_FIRST FIELD_APAR_AM
+#define FIELD_APGS_FIRST FIELD_APGS_NBS
+#define FIELD_APLS_FIRST FIELD_APLS_NBS
+
+// tx_field_t describes one schema entry.  Keys are stored inline so
+// that the table holds no pointers needing PIC() relocation.
+typedef struct {
+  char key[8];
+  uint8_t kind;
+  uint8_t type;
+  uint16_t offset;          // offset of the value in txn_t
+  uint16_t size;            // size of the value in txn_t
+  uint16_t max;             // max length of a variable-length value
+} tx_field_t;
+
+extern const tx_field_t tx_fields[FIELD_COUNT];
+
+// The most bytes the strings of a transaction take, each at its max.
+#define FIELD_STR_MAX(id, key, kind, type, member, max) + ((kind) == KIND_STR ? (max) : 0)
+enum {
+  TX_STRINGS_MAX = 0 TXN_FIELDS(FIELD_STR_MAX) APAR_FIELDS(FIELD_STR_MAX)
+                     APGS_FIELDS(FIELD_STR_MAX) APLS_FIELDS(FIELD_STR_MAX)
+};
+#undef FIELD_STR_MAX
+
+// tx_map_fields sets [*first, *end) to the tx_fields[] range of the
+// keys of a map: the transaction itself for FIELD_COUNT, or the nested
+// map that is the value of a KIND_MAP field.
+void tx_map_fields(uint8_t field, uint8_t *first, uint8_t *end);
+
+// tx_view returns the bytes of a view in t.
+const uint8_t *tx_view(const txn_t *t, tx_view_t v);
+
 // tx_encode produces a canonical msgpack encoding of a transaction.
 // buflen is the size of the buffer.  The return value is the length
-// of the resulting encoding.
+// of the resulting encoding, or 0 if t holds a value that cannot be
+// encoded, such as one of which only a digest is kept.
 unsigned int tx_encode(txn_t *t, uint8_t *buf, int buflen);
 
+// tx_apply_delta changes the transaction fields of t listed in delta,
+// each as {key length} {key} {value length} {value}: integers are
+// big-endian, booleans one byte, and an empty value clears a field.
+// The strings of t, old and new, are copied to arena, so that t no
+// longer refers to its encoding.  The type, nested maps and values
+// kept as digests cannot be changed, and t must hold none of the latter
+// in the end, so that tx_encode can encode it again.  The return value
+// is 1 on success, or 0 if the delta cannot apply; t is then garbled.
+int tx_apply_delta(txn_t *t, const uint8_t *delta, size_t len,
+                   uint8_t *arena, size_t arena_size);
+
+// Networks that a compact transaction may name by index instead of
+// carrying their genesis ID and hash.
+typedef struct {
+  char id[16];
+  uint8_t hash[32];
+} tx_network_t;
+
+#define TX_NETWORK_MAINNET 0
+#define TX_NETWORK_TESTNET 1
+#define TX_NETWORK_BETANET 2
+#define TX_NETWORK_COUNT   3
+#define TX_NETWORK_NONE    0xff
+
+extern const tx_network_t tx_networks[TX_NETWORK_COUNT];
+
+// The wire IDs of the fields of a compact transaction, as bits of its
+// field bitmap, listed as X(wire ID, field).  They are part of the wire
+// format, and do not follow tx_fields[]: a new field takes the next
+// free ID, and an ID never changes or goes to another field.
+#define TX_COMPACT_FIELDS(X)            \
+  X(0,  FIELD_AAMT)                     \
+  X(1,  FIELD_ACLOSE)                   \
+  X(2,  FIELD_AFRZ)                     \
+  X(3,  FIELD_AMT)                      \
+  X(4,  FIELD_APAA)                     \
+  X(5,  FIELD_APAN)                     \
+  X(6,  FIELD_APAP)                     \
+  X(7,  FIELD_APAR)                     \
+  X(8,  FIELD_APAS)                     \
+  X(9,  FIELD_APAT)                     \
+  X(10, FIELD_APEP)                     \
+  X(11, FIELD_APFA)                     \
+  X(12, FIELD_APGS)                     \
+  X(13, FIELD_APID)                     \
+  X(14, FIELD_APLS)                     \
+  X(15, FIELD_APSU)                     \
+  X(16, FIELD_ARCV)                     \
+  X(17, FIELD_ASND)                     \
+  X(18, FIELD_CAID)                     \
+  X(19, FIELD_CLOSE)                    \
+  X(20, FIELD_FADD)                     \
+  X(21, FIELD_FAID)                     \
+  X(22, FIELD_FEE)                      \
+  X(23, FIELD_FV)                       \
+  X(24, FIELD_GEN)                      \
+  X(25, FIELD_GH)                       \
+  X(26, FIELD_GRP)                      \
+  X(27, FIELD_LV)                       \
+  X(28, FIELD_LX)                       \
+  X(29, FIELD_NONPART)                  \
+  X(30, FIELD_NOTE)                     \
+  X(31, FIELD_RCV)                      \
+  X(32, FIELD_REKEY)                    \
+  X(33, FIELD_SELKEY)                   \
+  X(34, FIELD_SND)                      \
+  X(35, FIELD_TYPE)                     \
+  X(36, FIELD_VOTEFST)                  \
+  X(37, FIELD_VOTEKD)                   \
+  X(38, FIELD_VOTEKEY)                  \
+  X(39, FIELD_VOTELST)                  \
+  X(40, FIELD_XAID)                     \
+  X(41, FIELD_APAR_AM)                  \
+  X(42, FIELD_APAR_AN)                  \
+  X(43, FIELD_APAR_AU)                  \
+  X(44, FIELD_APAR_C)                   \
+  X(45, FIELD_APAR_DC)                  \
+  X(46, FIELD_APAR_DF)                  \
+  X(47, FIELD_APAR_F)                   \
+  X(48, FIELD_APAR_M)                   \
+  X(49, FIELD_APAR_R)                   \
+  X(50, FIELD_APAR_T)                   \
+  X(51, FIELD_APAR_UN)                  \
+  X(52, FIELD_APGS_NBS)                 \
+  X(53, FIELD_APGS_NUI)                 \
+  X(54, FIELD_APLS_NBS)                 \
+  X(55, FIELD_APLS_NUI)
+
+#define TX_COMPACT_ID_COUNT 56    // one past the last wire ID
+
+// The field of each wire ID.
+extern const uint8_t tx_compact_fields[TX_COMPACT_ID_COUNT];
+
+// Bytes of the field-presence bitmap of a compact transaction.
+#define TX_COMPACT_BITMAP_LEN ((TX_COMPACT_ID_COUNT + 7) / 8)
+
+// tx_decode_compact unpacks a compact transaction into t, which must be
+// zeroed beforehand (but for its accountId).  The encoding is
+//
+//   {type} {network} {bitmap} {values}
+//
+// where the type is an enum TXTYPE, the network an index in
+// tx_networks[] or TX_NETWORK_NONE, and bit i of the bitmap (bit i % 8
+// of byte i / 8) tells that the field of wire ID i has a value.  The
+// values of the fields follow in wire ID order: integers as LEB128
+// varints, byte strings of fixed size as is, strings and notes as
+// {length} {bytes}, and none for booleans, which are true.  Nested
+// maps are implied by their fields; the type, the maps themselves and
+// values kept as digests cannot be set.  Strings are copied to arena,
+// as for tx_apply_delta.  The return value is 1 on success, or 0 if the
+// encoding is malformed.  The result is not checked further: encode
+// and decode it again for that.
+int tx_decode_compact(txn_t *t, const uint8_t *buf, size_t len,
+                      uint8_t *arena, size_t arena_size);
+
+// Decoder status codes.  Decoding reports a code, and leaves the
+// details (err_arg and the decoder state) in the tx_decoder_t, so
+// that no error text is formatted unless the caller asks for it.
+enum TXDEC_STATUS {
+  TXDEC_OK,
+  TXDEC_ERR_MAP_HDR,        // err_arg: header byte
+  TXDEC_ERR_MAP_NONCANON,   // err_arg: entry count
+  TXDEC_ERR_EMPTY_PARAMS,
+  TXDEC_ERR_KEY_HDR,        // err_arg: header byte
+  TXDEC_ERR_KEY_LEN,        // err_arg: key length
+  TXDEC_ERR_KEY,            // err_arg: cursor past the last accepted key
+  TXDEC_ERR_MIXED_TYPES,
+  TXDEC_ERR_TX_TYPE,        // tbuf: type string
+  TXDEC_ERR_UINT_HDR,       // err_arg: header byte
+  TXDEC_ERR_UINT_ZERO,
+  TXDEC_ERR_UINT_NONCANON,  // err_arg: header byte
+  TXDEC_ERR_BOOL_HDR,       // err_arg: header byte
+  TXDEC_ERR_BOOL_FALSE,
+  TXDEC_ERR_STR_HDR,        // err_arg: header byte
+  TXDEC_ERR_STR_NONCANON,   // err_arg: length
+  TXDEC_ERR_STR_EMPTY,
+  TXDEC_ERR_STR_LEN,        // err_arg: length, maxlen: max length
+  TXDEC_ERR_STR_NUL,        // err_arg: offset of the NUL byte
+  TXDEC_ERR_ARENA_FULL,     // err_arg: length
+  TXDEC_ERR_BIN_HDR,        // err_arg: header byte
+  TXDEC_ERR_BIN_NONCANON,   // err_arg: length
+  TXDEC_ERR_BIN_EMPTY,
+  TXDEC_ERR_BIN_LEN,        // err_arg: length, dstlen or maxlen: size
+  TXDEC_ERR_BIN_ZERO,
+  TXDEC_ERR_ARR_HDR,        // err_arg: header byte
+  TXDEC_ERR_ARR_NONCANON,   // err_arg: element count
+  TXDEC_ERR_ARR_EMPTY,
+  TXDEC_ERR_ARR_LEN,        // err_arg: element count, maxlen: max count
+  TXDEC_ERR_TRAILING,
+  TXDEC_ERR_TRUNCATED,
+  TXDEC_ERR_MISSING_TYPE,
+  TXDEC_ERR_TYPE_MISMATCH,
+  TXDEC_ERR_ARGS_LEN,       // err_arg: length of the argument over the limit
+};
+
 // tx_decode takes a canonical msgpack encoding of a transaction, and
-// unpacks it into a txn_t.  The return value is NULL for success,
-// or a string describing the error on failure.  Decoding may or may
-// not succeed for a non-canonical encoding.
-char* tx_decode(uint8_t *buf, int buflen, txn_t *t);
+// unpacks it into a txn_t.  The return value is TXDEC_OK for success,
+// or a TXDEC_ERR_* code on failure.  Decoding fails for a non-canonical
+// encoding (unsorted or unknown keys, non-minimal integers, zero
+// values, fields foreign to the tx type, trailing bytes), so a
+// successfully decoded buffer can be signed as-is.
+int tx_decode(uint8_t *buf, int buflen, txn_t *t);
+
+// tx_decoder_t holds the state of a resumable decoder, so that a
+// transaction can be decoded chunk by chunk as APDUs arrive, keeping
+// only the parse state and a running hash between chunks.
+typedef struct {
+  uint8_t state;
+  uint8_t depth;            // 0 for the txn map, 1 for a nested map
+  uint16_t map_left[2];     // entries left in the map at each depth
+  uint8_t cursor[2];        // first tx_fields[] entry the next key may be
+  uint8_t map_end[2];       // end of the map's tx_fields[] range
+  uint8_t arr_left;         // elements left in the array being decoded
+
+  uint8_t match;            // tx_fields[] entry matching the key so far
+  uint8_t key_len;
+  uint8_t key_pos;
+
+  // Value being decoded, and where it goes
+  uint8_t kind;
+  uint8_t hdr;
+  uint8_t len_left;         // length or integer bytes still expected
+  uint8_t nonzero;
+  uint16_t len;
+  uint16_t pos;
+  uint64_t u64;
+  void *dst;
+  size_t dstlen;
+  uint16_t maxlen;
+  uint16_t *lenp;
+  uint8_t *digest;
+  char tbuf[16];
+
+  uint16_t off;             // offset of the next byte in the encoding
+  uint16_t grp_off;         // offset of the "grp" key, if any
+
+  // Where viewed values go: arena, if set, gets a copy of them;
+  // otherwise the caller keeps the encoding at view_base.
+  uint8_t *arena;
+  uint16_t arena_size;
+  uint16_t arena_used;
+
+  enum TXTYPE field_type;   // type implied by type-specific fields
+  uint8_t err;              // TXDEC_ERR_* once in DEC_ERROR
+  uint16_t err_arg;
+  cx_sha512_t hash;         // SHA512/256 of "TX" || bytes fed so far
+  cx_sha512_t value_hash;   // SHA512/256 of a digested value
+} tx_decoder_t;
+
+// tx_decoder_init resets t (except for its accountId) and d.  The
+// views in t refer to enc, where the caller keeps the fed bytes one
+// after the other.  tx_decoder_init_arena is for callers that do not
+// keep the fed bytes: the viewed values are copied into arena instead.
+// tx_decoder_feed decodes the next buflen bytes of the encoding into t.
+// tx_decoder_finish checks that a complete transaction was decoded and,
+// if txid is not NULL, stores the 32-byte transaction ID there.  Both
+// return TXDEC_OK on success, or a TXDEC_ERR_* code; once an error is
+// returned, every later call returns it as well.
+void tx_decoder_init(tx_decoder_t *d, txn_t *t, const uint8_t *enc);
+void tx_decoder_init_arena(tx_decoder_t *d, txn_t *t, uint8_t *arena, size_t arena_size);
+int tx_decoder_feed(tx_decoder_t *d, txn_t *t, const uint8_t *buf, size_t buflen);
+int tx_decoder_finish(tx_decoder_t *d, txn_t *t, uint8_t *txid);
 
 // We have a global transaction that is the subject of the current
 // operation, if any.
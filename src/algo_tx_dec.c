@@ -1,324 +1,755 @@
 #include <string.h>
 #include "os.h"
+#include "cx.h"
 
 #include "algo_tx.h"
+#include "algo_addr.h"
 #include "msgpack.h"
 
-static char decode_err[64];
+// Decoder states: which part of the encoding the next input byte
+// belongs to.
+enum {
+  DEC_MAP_HDR,
+  DEC_MAP_LEN,
+  DEC_KEY_HDR,
+  DEC_KEY,
+  DEC_VAL_HDR,
+  DEC_VAL_LEN,
+  DEC_VAL_UINT,
+  DEC_VAL_BYTES,
+  DEC_DONE,
+  DEC_ERROR,
+};
 
-static uint8_t
-next_byte(uint8_t **bufp, uint8_t *buf_end)
+// dec_fail records a decoding error.  The decoder stays in DEC_ERROR,
+// keeping err and err_arg (and the state they refer to) for the caller
+// to report.
+static int
+dec_fail(tx_decoder_t *d, uint8_t err, uint16_t arg)
 {
-  if (*bufp >= buf_end) {
-    snprintf(decode_err, sizeof(decode_err), "decode past end");
-    THROW(INVALID_PARAMETER);
+  d->state = DEC_ERROR;
+  d->err = err;
+  d->err_arg = arg;
+  return err;
+}
+
+static void
+set_field(tx_decoder_t *d, uint8_t kind, void *dst, size_t dstlen)
+{
+  d->kind = kind;
+  d->dst = dst;
+  d->dstlen = dstlen;
+}
+
+// expect_type records that the current field only belongs to
+// transactions of the given type.  Since we sign the received bytes
+// as they stand, fields from different types must not be mixed.
+static int
+expect_type(tx_decoder_t *d, enum TXTYPE type)
+{
+  if (d->field_type != UNKNOWN && d->field_type != type) {
+    return dec_fail(d, TXDEC_ERR_MIXED_TYPES, 0);
   }
 
-  uint8_t b = **bufp;
-  (*bufp)++;
-  return b;
+  d->field_type = type;
+  return TXDEC_OK;
 }
 
-static unsigned int
-decode_fixsz(uint8_t **bufp, uint8_t *buf_end, uint8_t fix_first, uint8_t fix_last)
+// Only the cursor is kept, not the key, so an unknown key cannot be
+// told apart from a known one out of canonical order; err_arg is the
+// cursor, which names the last key accepted in the map.
+static int
+key_error(tx_decoder_t *d)
 {
-  uint8_t b = next_byte(bufp, buf_end);
-  if (b < fix_first || b > fix_last) {
-    snprintf(decode_err, sizeof(decode_err), "decode %d wrong type (%d-%d)", b, fix_first, fix_last);
-    THROW(INVALID_PARAMETER);
+  return dec_fail(d, TXDEC_ERR_KEY, d->cursor[d->depth]);
+}
+
+// decode_key_byte matches the next key byte against the schema.
+// Canonical maps list their keys in strictly increasing order, so
+// the match only ever moves forward from the field after the previous
+// key: each key costs a few byte compares instead of a lookup, and
+// unsorted or duplicate keys fail as soon as a byte cannot match.
+static int
+decode_key_byte(tx_decoder_t *d, uint8_t b)
+{
+  uint8_t i = d->key_pos;
+  uint8_t end = d->map_end[d->depth];
+
+  // tx_fields[d->match] is the first field at or after the cursor
+  // whose key starts with the i bytes seen so far.  Since keys are
+  // sorted, fields sharing that prefix are adjacent.
+  while ((uint8_t) tx_fields[d->match].key[i] < b) {
+    if (d->match + 1 == end ||
+        os_memcmp(tx_fields[d->match].key, tx_fields[d->match + 1].key, i) != 0) {
+      return key_error(d);
+    }
+
+    d->match++;
   }
 
-  return b - fix_first;
+  if ((uint8_t) tx_fields[d->match].key[i] != b) {
+    return key_error(d);
+  }
+
+  d->key_pos++;
+  return TXDEC_OK;
 }
 
-static void
-decode_string(uint8_t **bufp, uint8_t *buf_end, char *strbuf, size_t strbuflen)
+static int
+decode_key_done(tx_decoder_t *d, txn_t *t)
 {
-  uint8_t b = next_byte(bufp, buf_end);
-  uint8_t str_len = 0;
-  if (b >= FIXSTR_0 && b <= FIXSTR_31) {
-    str_len = b - FIXSTR_0;
-  } else if (b == STR8) {
-    str_len = next_byte(bufp, buf_end);
+  const tx_field_t *f = &tx_fields[d->match];
+
+  if (f->key[d->key_len] != '\0') {
+    return key_error(d);
+  }
+
+  d->cursor[d->depth] = d->match + 1;
+
+  // A group member's ID for its group leaves out the "grp" entry.
+  if (d->match == FIELD_GRP) {
+    d->grp_off = d->off - d->key_len - 1;
+  }
+
+  // We decode type-specific fields into their union location
+  // on the assumption that the caller (host) passed in a valid
+  // transaction.  expect_type() rejects transactions that mix
+  // fields from more than one type.
+  if (f->type != ALL_TYPES && expect_type(d, f->type) != TXDEC_OK) {
+    return d->err;
+  }
+
+  if (f->kind == KIND_TYPE) {
+    set_field(d, KIND_TYPE, d->tbuf, sizeof(d->tbuf)-1);
+    d->maxlen = sizeof(d->tbuf)-1;
   } else {
-    snprintf(decode_err, sizeof(decode_err), "expected string, found %d", b);
-    THROW(INVALID_PARAMETER);
+    set_field(d, f->kind, (uint8_t *) t + f->offset, f->size);
+    d->maxlen = f->max;
+  }
+
+  switch (f->kind) {
+  case KIND_BIN_DIGEST:
+    // The note is the only field kept as a preview and digest.
+    d->lenp = &t->note_len;
+    d->digest = t->note_hash;
+    break;
+
+  case KIND_BIN_HASH:
+  case KIND_ARR_BIN:
+  case KIND_ARR_ADDR:
+  case KIND_ARR_UINT: {
+    tx_digest_t *dg = d->dst;
+    d->lenp = &dg->len;
+    d->digest = dg->hash;
+    set_field(d, f->kind, NULL, 0);
+    break;
   }
 
-  if (str_len > strbuflen) {
-    snprintf(decode_err, sizeof(decode_err), "%d-byte string too big for %d-byte buf", str_len, strbuflen);
-    THROW(INVALID_PARAMETER);
+  case KIND_MAP:
+    tx_map_fields(d->match, &d->cursor[1], &d->map_end[1]);
+    break;
   }
 
-  if (*bufp + str_len > buf_end) {
-    snprintf(decode_err, sizeof(decode_err), "%d-byte string overruns input", str_len);
-    THROW(INVALID_PARAMETER);
+  d->state = DEC_VAL_HDR;
+  return TXDEC_OK;
+}
+
+static int
+decode_type(tx_decoder_t *d, txn_t *t)
+{
+  char *tbuf = d->tbuf;
+
+  if (!strcmp(tbuf, "pay")) {
+    t->type = PAYMENT;
+  } else if (!strcmp(tbuf, "keyreg")) {
+    t->type = KEYREG;
+  } else if (!strcmp(tbuf, "axfer")) {
+    t->type = ASSET_XFER;
+  } else if (!strcmp(tbuf, "afrz")) {
+    t->type = ASSET_FREEZE;
+  } else if (!strcmp(tbuf, "acfg")) {
+    t->type = ASSET_CONFIG;
+  } else if (!strcmp(tbuf, "appl")) {
+    t->type = APPLICATION;
+  } else {
+    return dec_fail(d, TXDEC_ERR_TX_TYPE, 0);
   }
 
-  os_memmove(strbuf, *bufp, str_len);
-  if (str_len < strbuflen) {
-    strbuf[str_len] = 0;
+  return TXDEC_OK;
+}
+
+// decode_map_len starts a map of map_count entries.  The cursor and
+// end of its tx_fields[] range are already set.
+static int
+decode_map_len(tx_decoder_t *d, uint16_t map_count)
+{
+  if (d->hdr == MAP16 && map_count <= FIXMAP_15 - FIXMAP_0) {
+    return dec_fail(d, TXDEC_ERR_MAP_NONCANON, map_count);
+  }
+
+  d->map_left[d->depth] = map_count;
+
+  if (map_count == 0) {
+    if (d->depth > 0) {
+      return dec_fail(d, TXDEC_ERR_EMPTY_PARAMS, 0);
+    }
+
+    d->state = DEC_DONE;
+    return TXDEC_OK;
   }
-  *bufp += str_len;
+
+  d->state = DEC_KEY_HDR;
+  return TXDEC_OK;
 }
 
-static void
-decode_string_nullterm(uint8_t **bufp, uint8_t *buf_end, char *strbuf, size_t strbuflen)
+static int
+decode_map_hdr(tx_decoder_t *d, uint8_t b)
 {
-  if (strbuflen == 0) {
-    snprintf(decode_err, sizeof(decode_err), "decode_string_nullterm: zero strbuflen");
-    THROW(INVALID_PARAMETER);
+  d->hdr = b;
+
+  if (b >= FIXMAP_0 && b <= FIXMAP_15) {
+    return decode_map_len(d, b - FIXMAP_0);
   }
 
-  decode_string(bufp, buf_end, strbuf, strbuflen-1);
-  strbuf[strbuflen-1] = '\0';
+  if (b != MAP16) {
+    return dec_fail(d, TXDEC_ERR_MAP_HDR, b);
+  }
+
+  d->len = 0;
+  d->len_left = 2;
+  d->state = DEC_MAP_LEN;
+  return TXDEC_OK;
 }
 
-static void
-decode_bin_fixed(uint8_t **bufp, uint8_t *buf_end, uint8_t *res, size_t reslen)
+static int
+decode_key_hdr(tx_decoder_t *d, uint8_t b)
 {
-  uint8_t b = next_byte(bufp, buf_end);
-  if (b != BIN8) {
-    snprintf(decode_err, sizeof(decode_err), "expected bin, found %d", b);
-    THROW(INVALID_PARAMETER);
+  // Every known key is a short fixstr, so anything else can only be
+  // an unknown or non-canonical key.
+  if (b < FIXSTR_0 || b > FIXSTR_31) {
+    return dec_fail(d, TXDEC_ERR_KEY_HDR, b);
   }
 
-  uint8_t bin_len = next_byte(bufp, buf_end);
-  if (bin_len != reslen) {
-    snprintf(decode_err, sizeof(decode_err), "expected %d bin bytes, found %d", reslen, bin_len);
-    THROW(INVALID_PARAMETER);
+  d->key_len = b - FIXSTR_0;
+  d->key_pos = 0;
+  d->match = d->cursor[d->depth];
+
+  if (d->key_len == 0 || d->key_len >= sizeof(tx_fields[0].key)) {
+    return dec_fail(d, TXDEC_ERR_KEY_LEN, d->key_len);
   }
 
-  if (*bufp + bin_len > buf_end) {
-    snprintf(decode_err, sizeof(decode_err), "%d-byte bin overruns input", bin_len);
-    THROW(INVALID_PARAMETER);
+  // No field sorts after the previous key of this map.
+  if (d->match == d->map_end[d->depth]) {
+    return key_error(d);
   }
 
-  os_memmove(res, *bufp, bin_len);
-  *bufp += bin_len;
+  d->state = DEC_KEY;
+  return TXDEC_OK;
+}
+
+static void
+digest_done(tx_decoder_t *d)
+{
+  uint8_t hash[64];
+  cx_hash(&d->value_hash.header, CX_LAST, NULL, 0, hash, sizeof(hash));
+  os_memmove(d->digest, hash, 32);
 }
 
+// Array elements are not kept, only hashed into the array's digest,
+// each prefixed with its length if it is a byte string.
 static void
-decode_bin_var(uint8_t **bufp, uint8_t *buf_end, uint8_t *res, size_t *reslen, size_t reslenmax)
+digest_u16(tx_decoder_t *d, uint16_t v)
 {
-  uint8_t b = next_byte(bufp, buf_end);
-  uint16_t bin_len = 0;
-
-  if (b == BIN8) {
-    bin_len = next_byte(bufp, buf_end);
-  } else if (b == BIN16) {
-    bin_len = next_byte(bufp, buf_end);
-    bin_len = (bin_len << 8) | next_byte(bufp, buf_end);
+  uint8_t be[2] = { v >> 8, v & 0xff };
+  cx_hash(&d->value_hash.header, 0, be, sizeof(be), NULL, 0);
+}
+
+static void
+decode_value_done(tx_decoder_t *d)
+{
+  if (d->arr_left > 0) {
+    if (--d->arr_left > 0) {
+      d->state = DEC_VAL_HDR;
+      return;
+    }
+
+    digest_done(d);
+  }
+
+  d->map_left[d->depth]--;
+
+  // Finishing the last entry of a nested map also finishes the
+  // parent entry whose value it was.
+  while (d->map_left[d->depth] == 0) {
+    if (d->depth == 0) {
+      d->state = DEC_DONE;
+      return;
+    }
+
+    d->depth--;
+    d->map_left[d->depth]--;
+  }
+
+  d->state = DEC_KEY_HDR;
+}
+
+static int
+decode_uint_done(tx_decoder_t *d)
+{
+  uint8_t b = d->hdr;
+  uint64_t v = d->u64;
+
+  // Canonical encoding omits zero values (but not zero array
+  // elements) and uses the narrowest representation that holds the
+  // value.
+  if (v == 0 && d->arr_left == 0) {
+    return dec_fail(d, TXDEC_ERR_UINT_ZERO, 0);
+  }
+
+  if ((b == UINT8  && v <= FIXINT_127 - FIXINT_0) ||
+      (b == UINT16 && v < (1ULL << 8)) ||
+      (b == UINT32 && v < (1ULL << 16)) ||
+      (b == UINT64 && v < (1ULL << 32))) {
+    return dec_fail(d, TXDEC_ERR_UINT_NONCANON, b);
+  }
+
+  if (d->arr_left > 0) {
+    uint8_t be[8];
+    for (int i = 0; i < 8; i++) {
+      be[i] = v >> (56 - 8 * i);
+    }
+    cx_hash(&d->value_hash.header, 0, be, sizeof(be), NULL, 0);
   } else {
-    snprintf(decode_err, sizeof(decode_err), "expected bin, found %d", b);
-    THROW(INVALID_PARAMETER);
+    *(uint64_t *) d->dst = v;
   }
 
-  if (bin_len > reslenmax) {
-    snprintf(decode_err, sizeof(decode_err), "expected <= %d bin bytes, found %d", reslenmax, bin_len);
-    THROW(INVALID_PARAMETER);
+  decode_value_done(d);
+  return TXDEC_OK;
+}
+
+// decode_arr_len starts the elements of an array, which are decoded
+// as values of the element kind until arr_left drops to zero.
+static int
+decode_arr_len(tx_decoder_t *d)
+{
+  uint16_t len = d->len;
+
+  if (d->hdr == ARR16 && len <= FIXARR_15 - FIXARR_0) {
+    return dec_fail(d, TXDEC_ERR_ARR_NONCANON, len);
   }
 
-  if (*bufp + bin_len > buf_end) {
-    snprintf(decode_err, sizeof(decode_err), "%d-byte bin overruns input", bin_len);
-    THROW(INVALID_PARAMETER);
+  if (len == 0) {
+    return dec_fail(d, TXDEC_ERR_ARR_EMPTY, 0);
   }
 
-  os_memmove(res, *bufp, bin_len);
-  *bufp += bin_len;
-  *reslen = bin_len;
+  if (len > d->maxlen) {
+    return dec_fail(d, TXDEC_ERR_ARR_LEN, len);
+  }
+
+  *d->lenp = len;
+  sha512_256_init(&d->value_hash);
+
+  switch (d->kind) {
+  case KIND_ARR_BIN:
+    set_field(d, KIND_BIN_HASH, NULL, 0);
+    d->maxlen = APP_ARGS_MAX_LEN;
+    break;
+
+  case KIND_ARR_ADDR:
+    set_field(d, KIND_BIN_FIXED, NULL, 32);
+    break;
+
+  case KIND_ARR_UINT:
+    set_field(d, KIND_UINT64, NULL, 0);
+    break;
+  }
+
+  d->arr_left = len;
+  d->state = DEC_VAL_HDR;
+  return TXDEC_OK;
 }
 
-static void
-decode_uint64(uint8_t **bufp, uint8_t *buf_end, uint64_t *res)
+static int
+decode_len_done(tx_decoder_t *d)
 {
-  uint8_t b = next_byte(bufp, buf_end);
-  if (b >= FIXINT_0 && b <= FIXINT_127) {
-    *res = b - FIXINT_0;
-  } else if (b == UINT8) {
-    *res = next_byte(bufp, buf_end);
-  } else if (b == UINT16) {
-    *res = next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-  } else if (b == UINT32) {
-    *res = next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-  } else if (b == UINT64) {
-    *res = next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-    *res = (*res << 8) | next_byte(bufp, buf_end);
-  } else {
-    snprintf(decode_err, sizeof(decode_err), "expected u64, found %d", b);
-    THROW(INVALID_PARAMETER);
+  uint16_t len = d->len;
+
+  switch (d->kind) {
+  case KIND_ARR_BIN:
+  case KIND_ARR_ADDR:
+  case KIND_ARR_UINT:
+    return decode_arr_len(d);
+
+  case KIND_STR:
+  case KIND_TYPE:
+    if (d->hdr == STR8 && len <= FIXSTR_31 - FIXSTR_0) {
+      return dec_fail(d, TXDEC_ERR_STR_NONCANON, len);
+    }
+
+    if (len == 0) {
+      return dec_fail(d, TXDEC_ERR_STR_EMPTY, 0);
+    }
+
+    if (len > d->maxlen) {
+      return dec_fail(d, TXDEC_ERR_STR_LEN, len);
+    }
+
+    if (d->kind == KIND_STR) {
+      tx_view_t *v = d->dst;
+
+      // The value is either left where it is in the encoding, or
+      // copied to the arena as its bytes arrive.
+      v->len = len;
+      if (d->arena == NULL) {
+        v->off = d->off;
+      } else {
+        if (len > d->arena_size - d->arena_used) {
+          return dec_fail(d, TXDEC_ERR_ARENA_FULL, len);
+        }
+
+        v->off = d->arena_used;
+        d->arena_used += len;
+      }
+    }
+    break;
+
+  case KIND_BIN_FIXED:
+    if (len != d->dstlen) {
+      return dec_fail(d, TXDEC_ERR_BIN_LEN, len);
+    }
+
+    if (d->arr_left > 0) {
+      digest_u16(d, len);
+    }
+    break;
+
+  case KIND_BIN_DIGEST:
+  case KIND_BIN_HASH:
+    if (d->hdr == BIN16 && len < (1 << 8)) {
+      return dec_fail(d, TXDEC_ERR_BIN_NONCANON, len);
+    }
+
+    if (len > d->maxlen) {
+      if (d->arr_left > 0) {
+        return dec_fail(d, TXDEC_ERR_ARGS_LEN, len);
+      }
+      return dec_fail(d, TXDEC_ERR_BIN_LEN, len);
+    }
+
+    if (d->arr_left > 0) {
+      // The limit is on the total length of the elements: maxlen is
+      // what is left of it.
+      d->maxlen -= len;
+
+      // An empty byte string is a valid array element.
+      digest_u16(d, len);
+      if (len == 0) {
+        decode_value_done(d);
+        return TXDEC_OK;
+      }
+      break;
+    }
+
+    if (len == 0) {
+      return dec_fail(d, TXDEC_ERR_BIN_EMPTY, 0);
+    }
+
+    *d->lenp = len;
+    sha512_256_init(&d->value_hash);
+    break;
   }
+
+  d->pos = 0;
+  d->state = DEC_VAL_BYTES;
+  return TXDEC_OK;
 }
 
-static void
-decode_bool(uint8_t **bufp, uint8_t *buf_end, uint8_t *res)
+static int
+decode_bytes_done(tx_decoder_t *d, txn_t *t)
 {
-  uint8_t b = next_byte(bufp, buf_end);
-  if (b == BOOL_TRUE) {
-    *res = 1;
-  } else if (b == BOOL_FALSE) {
-    *res = 0;
-  } else {
-    snprintf(decode_err, sizeof(decode_err), "expected bool, found %d", b);
-    THROW(INVALID_PARAMETER);
+  if (d->kind == KIND_BIN_FIXED && !d->nonzero && d->arr_left == 0) {
+    return dec_fail(d, TXDEC_ERR_BIN_ZERO, 0);
+  }
+
+  if (d->kind == KIND_TYPE) {
+    d->tbuf[d->len] = '\0';
+    if (decode_type(d, t) != TXDEC_OK) {
+      return d->err;
+    }
+  }
+
+  if ((d->kind == KIND_BIN_DIGEST || d->kind == KIND_BIN_HASH) && d->arr_left == 0) {
+    digest_done(d);
   }
+
+  decode_value_done(d);
+  return TXDEC_OK;
 }
 
-static void
-decode_asset_params(uint8_t **bufp, uint8_t *buf_end, struct asset_params *res)
+static int
+decode_value_hdr(tx_decoder_t *d, uint8_t b)
 {
-  uint8_t map_count = decode_fixsz(bufp, buf_end, FIXMAP_0, FIXMAP_15);
-  for (int i = 0; i < map_count; i++) {
-    char key[32];
-    decode_string_nullterm(bufp, buf_end, key, sizeof(key));
-
-    if (!strcmp(key, "t")) {
-      decode_uint64(bufp, buf_end, &res->total);
-    } else if (!strcmp(key, "dc")) {
-      decode_uint64(bufp, buf_end, &res->decimals);
-    } else if (!strcmp(key, "df")) {
-      decode_bool(bufp, buf_end, &res->default_frozen);
-    } else if (!strcmp(key, "un")) {
-      decode_string(bufp, buf_end, res->unitname, sizeof(res->unitname));
-    } else if (!strcmp(key, "an")) {
-      decode_string(bufp, buf_end, res->assetname, sizeof(res->assetname));
-    } else if (!strcmp(key, "au")) {
-      decode_string(bufp, buf_end, res->url, sizeof(res->url));
-    } else if (!strcmp(key, "am")) {
-      decode_bin_fixed(bufp, buf_end, res->metadata_hash, sizeof(res->metadata_hash));
-    } else if (!strcmp(key, "m")) {
-      decode_bin_fixed(bufp, buf_end, res->manager, sizeof(res->manager));
-    } else if (!strcmp(key, "r")) {
-      decode_bin_fixed(bufp, buf_end, res->reserve, sizeof(res->reserve));
-    } else if (!strcmp(key, "f")) {
-      decode_bin_fixed(bufp, buf_end, res->freeze, sizeof(res->freeze));
-    } else if (!strcmp(key, "c")) {
-      decode_bin_fixed(bufp, buf_end, res->clawback, sizeof(res->clawback));
+  d->hdr = b;
+  d->u64 = 0;
+  d->len = 0;
+  d->nonzero = 0;
+
+  switch (d->kind) {
+  case KIND_UINT64:
+    if (b <= FIXINT_127) {  // FIXINT_0 is 0
+      d->u64 = b - FIXINT_0;
+      return decode_uint_done(d);
+    } else if (b == UINT8) {
+      d->len_left = 1;
+    } else if (b == UINT16) {
+      d->len_left = 2;
+    } else if (b == UINT32) {
+      d->len_left = 4;
+    } else if (b == UINT64) {
+      d->len_left = 8;
+    } else {
+      return dec_fail(d, TXDEC_ERR_UINT_HDR, b);
+    }
+    d->state = DEC_VAL_UINT;
+    return TXDEC_OK;
+
+  case KIND_BOOL:
+    if (b == BOOL_TRUE) {
+      *(uint8_t *) d->dst = 1;
+    } else if (b == BOOL_FALSE) {
+      return dec_fail(d, TXDEC_ERR_BOOL_FALSE, 0);
     } else {
-      snprintf(decode_err, sizeof(decode_err), "unknown params field %s", key);
-      THROW(INVALID_PARAMETER);
+      return dec_fail(d, TXDEC_ERR_BOOL_HDR, b);
     }
+    decode_value_done(d);
+    return TXDEC_OK;
+
+  case KIND_STR:
+  case KIND_TYPE:
+    if (b >= FIXSTR_0 && b <= FIXSTR_31) {
+      d->len = b - FIXSTR_0;
+      return decode_len_done(d);
+    } else if (b == STR8) {
+      d->len_left = 1;
+    } else {
+      return dec_fail(d, TXDEC_ERR_STR_HDR, b);
+    }
+    d->state = DEC_VAL_LEN;
+    return TXDEC_OK;
+
+  case KIND_BIN_FIXED:
+  case KIND_BIN_DIGEST:
+  case KIND_BIN_HASH:
+    if (b == BIN8) {
+      d->len_left = 1;
+    } else if (b == BIN16 && d->kind != KIND_BIN_FIXED) {
+      d->len_left = 2;
+    } else {
+      return dec_fail(d, TXDEC_ERR_BIN_HDR, b);
+    }
+    d->state = DEC_VAL_LEN;
+    return TXDEC_OK;
+
+  case KIND_ARR_BIN:
+  case KIND_ARR_ADDR:
+  case KIND_ARR_UINT:
+    if (b >= FIXARR_0 && b <= FIXARR_15) {
+      d->len = b - FIXARR_0;
+      return decode_len_done(d);
+    } else if (b == ARR16) {
+      d->len_left = 2;
+    } else {
+      return dec_fail(d, TXDEC_ERR_ARR_HDR, b);
+    }
+    d->state = DEC_VAL_LEN;
+    return TXDEC_OK;
+
+  case KIND_MAP:
+    d->depth++;
+    return decode_map_hdr(d, b);
   }
+
+  return TXDEC_OK;
 }
 
-char*
-tx_decode(uint8_t *buf, int buflen, txn_t *t)
+static int
+decode_byte(tx_decoder_t *d, uint8_t b)
+{
+  switch (d->state) {
+  case DEC_MAP_HDR:
+    return decode_map_hdr(d, b);
+
+  case DEC_MAP_LEN:
+    d->len = (d->len << 8) | b;
+    if (--d->len_left == 0) {
+      return decode_map_len(d, d->len);
+    }
+    return TXDEC_OK;
+
+  case DEC_KEY_HDR:
+    return decode_key_hdr(d, b);
+
+  case DEC_VAL_HDR:
+    return decode_value_hdr(d, b);
+
+  case DEC_VAL_LEN:
+    d->len = (d->len << 8) | b;
+    if (--d->len_left == 0) {
+      return decode_len_done(d);
+    }
+    return TXDEC_OK;
+
+  case DEC_VAL_UINT:
+    d->u64 = (d->u64 << 8) | b;
+    if (--d->len_left == 0) {
+      return decode_uint_done(d);
+    }
+    return TXDEC_OK;
+
+  case DEC_DONE:
+    return dec_fail(d, TXDEC_ERR_TRAILING, 0);
+  }
+
+  return TXDEC_OK;
+}
+
+void
+tx_decoder_init(tx_decoder_t *d, txn_t *t, const uint8_t *enc)
 {
-  char* ret = NULL;
-  uint8_t* buf_end = buf + buflen;
   uint32_t accountId = t->accountId; // Save `accountId`
 
   os_memset(t, 0, sizeof(*t));
   t->accountId = accountId;
+  t->view_base = enc;
+
+  os_memset(d, 0, sizeof(*d));
+  d->state = DEC_MAP_HDR;
+  d->field_type = UNKNOWN;
+  tx_map_fields(FIELD_COUNT, &d->cursor[0], &d->map_end[0]);
+
+  // The transaction ID is the SHA512/256 of the signed bytes.
+  sha512_256_init(&d->hash);
+  cx_hash(&d->hash.header, 0, (uint8_t *) "TX", 2, NULL, 0);
+}
+
+void
+tx_decoder_init_arena(tx_decoder_t *d, txn_t *t, uint8_t *arena, size_t arena_size)
+{
+  tx_decoder_init(d, t, arena);
+
+  d->arena = arena;
+  d->arena_size = arena_size;
+}
+
+int
+tx_decoder_feed(tx_decoder_t *d, txn_t *t, const uint8_t *buf, size_t buflen)
+{
+  const uint8_t *buf_end = buf + buflen;
+  int err = TXDEC_OK;
+
+  if (d->state == DEC_ERROR) {
+    return d->err;
+  }
+
+  cx_hash(&d->hash.header, 0, buf, buflen, NULL, 0);
 
-  BEGIN_TRY {
-    TRY {
-      uint8_t map_count = decode_fixsz(&buf, buf_end, FIXMAP_0, FIXMAP_15);
-      for (int i = 0; i < map_count; i++) {
-        char key[32];
-        decode_string_nullterm(&buf, buf_end, key, sizeof(key));
-
-        // We decode type-specific fields into their union location
-        // on the assumption that the caller (host) passed in a valid
-        // transaction.  If the transaction contains fields from more
-        // than one type of transaction, the in-memory value might be
-        // corrupted, but any in-memory representation for the union
-        // fields is valid.
-        if (!strcmp(key, "type")) {
-          char tbuf[16];
-          decode_string_nullterm(&buf, buf_end, tbuf, sizeof(tbuf));
-
-          if (!strcmp(tbuf, "pay")) {
-            t->type = PAYMENT;
-          } else if (!strcmp(tbuf, "keyreg")) {
-            t->type = KEYREG;
-          } else if (!strcmp(tbuf, "axfer")) {
-            t->type = ASSET_XFER;
-          } else if (!strcmp(tbuf, "afrz")) {
-            t->type = ASSET_FREEZE;
-          } else if (!strcmp(tbuf, "acfg")) {
-            t->type = ASSET_CONFIG;
-          } else {
-            snprintf(decode_err, sizeof(decode_err), "unknown tx type %s", tbuf);
-            THROW(INVALID_PARAMETER);
-          }
-        } else if (!strcmp(key, "snd")) {
-          decode_bin_fixed(&buf, buf_end, t->sender, sizeof(t->sender));
-        } else if (!strcmp(key, "rekey")) {
-          decode_bin_fixed(&buf, buf_end, t->rekey, sizeof(t->rekey));
-        } else if (!strcmp(key, "fee")) {
-          decode_uint64(&buf, buf_end, &t->fee);
-        } else if (!strcmp(key, "fv")) {
-          decode_uint64(&buf, buf_end, &t->firstValid);
-        } else if (!strcmp(key, "lv")) {
-          decode_uint64(&buf, buf_end, &t->lastValid);
-        } else if (!strcmp(key, "gen")) {
-          decode_string(&buf, buf_end, t->genesisID, sizeof(t->genesisID));
-        } else if (!strcmp(key, "gh")) {
-          decode_bin_fixed(&buf, buf_end, t->genesisHash, sizeof(t->genesisHash));
-        } else if (!strcmp(key, "note")) {
-          decode_bin_var(&buf, buf_end, t->note, &t->note_len, sizeof(t->note));
-        } else if (!strcmp(key, "amt")) {
-          decode_uint64(&buf, buf_end, &t->payment.amount);
-        } else if (!strcmp(key, "rcv")) {
-          decode_bin_fixed(&buf, buf_end, t->payment.receiver, sizeof(t->payment.receiver));
-        } else if (!strcmp(key, "close")) {
-          decode_bin_fixed(&buf, buf_end, t->payment.close, sizeof(t->payment.close));
-        } else if (!strcmp(key, "selkey")) {
-          decode_bin_fixed(&buf, buf_end, t->keyreg.vrfpk, sizeof(t->keyreg.vrfpk));
-        } else if (!strcmp(key, "votekey")) {
-          decode_bin_fixed(&buf, buf_end, t->keyreg.votepk, sizeof(t->keyreg.votepk));
-        } else if (!strcmp(key, "votefst")) {
-          decode_uint64(&buf, buf_end, &t->keyreg.voteFirst);
-        } else if (!strcmp(key, "votelst")) {
-          decode_uint64(&buf, buf_end, &t->keyreg.voteLast);
-        } else if (!strcmp(key, "votekd")) {
-          decode_uint64(&buf, buf_end, &t->keyreg.keyDilution);
-        } else if (!strcmp(key, "nonpart")) {
-          decode_bool(&buf, buf_end, &t->keyreg.nonpartFlag);
-        } else if (!strcmp(key, "aamt")) {
-          decode_uint64(&buf, buf_end, &t->asset_xfer.amount);
-        } else if (!strcmp(key, "aclose")) {
-          decode_bin_fixed(&buf, buf_end, t->asset_xfer.close, sizeof(t->asset_xfer.close));
-        } else if (!strcmp(key, "arcv")) {
-          decode_bin_fixed(&buf, buf_end, t->asset_xfer.receiver, sizeof(t->asset_xfer.receiver));
-        } else if (!strcmp(key, "asnd")) {
-          decode_bin_fixed(&buf, buf_end, t->asset_xfer.sender, sizeof(t->asset_xfer.sender));
-        } else if (!strcmp(key, "xaid")) {
-          decode_uint64(&buf, buf_end, &t->asset_xfer.id);
-        } else if (!strcmp(key, "faid")) {
-          decode_uint64(&buf, buf_end, &t->asset_freeze.id);
-        } else if (!strcmp(key, "fadd")) {
-          decode_bin_fixed(&buf, buf_end, t->asset_freeze.account, sizeof(t->asset_freeze.account));
-        } else if (!strcmp(key, "afrz")) {
-          decode_bool(&buf, buf_end, &t->asset_freeze.flag);
-        } else if (!strcmp(key, "caid")) {
-          decode_uint64(&buf, buf_end, &t->asset_config.id);
-        } else if (!strcmp(key, "apar")) {
-          decode_asset_params(&buf, buf_end, &t->asset_config.params);
-        } else {
-          snprintf(decode_err, sizeof(decode_err), "unknown field %s", key);
-          THROW(INVALID_PARAMETER);
+  while (buf < buf_end && err == TXDEC_OK) {
+    size_t avail = buf_end - buf;
+
+    if (d->state == DEC_KEY) {
+      d->off++;
+      err = decode_key_byte(d, *buf++);
+
+      if (err == TXDEC_OK && d->key_pos == d->key_len) {
+        err = decode_key_done(d, t);
+      }
+    } else if (d->state == DEC_VAL_BYTES) {
+      size_t n = d->len - d->pos;
+      if (n > avail) {
+        n = avail;
+      }
+
+      for (size_t i = 0; i < n; i++) {
+        d->nonzero |= buf[i];
+
+        // Strings are displayed up to their first NUL, so one
+        // inside a string would hide the rest from review.
+        if (buf[i] == 0 && (d->kind == KIND_STR || d->kind == KIND_TYPE)) {
+          return dec_fail(d, TXDEC_ERR_STR_NUL, d->pos + i);
         }
       }
+
+      if (d->kind == KIND_STR) {
+        if (d->arena != NULL) {
+          tx_view_t *v = d->dst;
+          os_memmove(d->arena + v->off + d->pos, buf, n);
+        }
+      } else if (d->dst != NULL && d->pos < d->dstlen) {
+        // Only the first dstlen bytes of a digested value are kept.
+        size_t keep = d->dstlen - d->pos;
+        os_memmove((uint8_t *) d->dst + d->pos, buf, n < keep ? n : keep);
+      }
+
+      if (d->kind == KIND_BIN_DIGEST || d->kind == KIND_BIN_HASH || d->arr_left > 0) {
+        cx_hash(&d->value_hash.header, 0, buf, n, NULL, 0);
+      }
+
+      d->pos += n;
+      d->off += n;
+      buf += n;
+
+      if (d->pos == d->len) {
+        err = decode_bytes_done(d, t);
+      }
+    } else {
+      d->off++;
+      err = decode_byte(d, *buf++);
     }
-    CATCH_OTHER(e) {
-      ret = &decode_err[0];
-    }
-    FINALLY {
-    }
   }
-  END_TRY;
 
-  return ret;
+  return err;
+}
+
+int
+tx_decoder_finish(tx_decoder_t *d, txn_t *t, uint8_t *txid)
+{
+  if (d->state == DEC_ERROR) {
+    return d->err;
+  }
+
+  if (d->state != DEC_DONE) {
+    return dec_fail(d, TXDEC_ERR_TRUNCATED, 0);
+  }
+
+  if (t->type == UNKNOWN) {
+    return dec_fail(d, TXDEC_ERR_MISSING_TYPE, 0);
+  }
+
+  if (d->field_type != UNKNOWN && d->field_type != t->type) {
+    return dec_fail(d, TXDEC_ERR_TYPE_MISMATCH, 0);
+  }
+
+  uint8_t hash[64];
+  cx_hash(&d->hash.header, CX_LAST, NULL, 0, hash, sizeof(hash));
+  if (txid != NULL) {
+    os_memmove(txid, hash, 32);
+  }
+
+  return TXDEC_OK;
+}
+
+int
+tx_decode(uint8_t *buf, int buflen, txn_t *t)
+{
+  tx_decoder_t d;
+  int err;
+
+  tx_decoder_init(&d, t, buf);
+
+  err = tx_decoder_feed(&d, t, buf, buflen);
+  if (err != TXDEC_OK) {
+    return err;
+  }
+
+  return tx_decoder_finish(&d, t, NULL);
 }
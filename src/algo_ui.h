@@ -5,10 +5,18 @@ extern char caption[20];
 extern char text[128];
 
 void ui_idle();
+void app_exit(void);
 void ui_address_approval();
-void ui_txn();
+// Review current_txn, whose ID is txid, or NULL if unknown (which
+// rules out the expert review).
+void ui_txn(const uint8_t *txid);
+// Review current_txn, to be signed by the count accounts.
+void ui_txn_signers(const uint8_t *txid, const uint32_t *accounts, uint8_t count);
 void ux_approve_txn();
 
+// Whether the user turned on expert mode in the settings.
+bool ui_expert_mode(void);
+
 void ui_text_put(const char *msg);
 void ui_text_putn(const char *msg, size_t maxlen);
 
@@ -6,6 +6,10 @@
 #include "algo_ui.h"
 #include "algo_addr.h"
 #include "algo_tx.h"
+#include "algo_eddsa.h"
+#include "algo_group.h"
+#include "algo_policy.h"
+#include "algo_program.h"
 
 unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
 
@@ -22,6 +26,8 @@ unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
 #define P1_MORE  0x80
 #define P1_WITH_ACCOUNT_ID  0x01
 #define P1_WITH_REQUEST_USER_APPROVAL  0x80
+#define P1_SECOND_PASS      0x40
+#define P1_SIGNED_TXN       0x02
 
 #define P2_LAST  0x00
 #define P2_MORE  0x80
@@ -34,50 +40,547 @@ unsigned char G_io_seproxyhal_spi_buffer[IO_SEPROXYHAL_BUFFER_SIZE_B];
 #define INS_SIGN_PAYMENT_V3 0x06
 #define INS_SIGN_KEYREG_V3  0x07
 #define INS_SIGN_MSGPACK    0x08
+#define INS_SIGN_MSGPACK_STREAM 0x09
+#define INS_SIGN_GROUP      0x0A
+#define INS_GET_PUBLIC_KEYS 0x0B
+#define INS_FIND_ACCOUNT    0x0C
+#define INS_SIGNING_SESSION 0x0D
+
+#define P1_SESSION_END      0x00
+#define P1_SESSION_START    0x01
+
+#define INS_SET_POLICY      0x0E
+#define INS_SIGN_PROGRAM    0x0F
+
+#define P1_FORGET_PROGRAMS  0x20
+
+#define INS_SIGN_MULTISIG   0x10
+#define INS_GET_SIGNED_TXN  0x11
+#define INS_SIGN_DELTA      0x12
+#define INS_SIGN_RESUMABLE  0x13
+#define INS_GET_LAST_SIGNATURE 0x14
+#define INS_GET_CONFIG      0x15
+#define INS_SIGN_COMPACT    0x16
+
+/* The INS codes answered, one bit each, for INS_GET_CONFIG. */
+#define SUPPORTED_INS                                                   \
+  ((1UL << INS_GET_PUBLIC_KEY) |                                        \
+   (1UL << INS_SIGN_PAYMENT_V2) | (1UL << INS_SIGN_KEYREG_V2) |         \
+   (1UL << INS_SIGN_PAYMENT_V3) | (1UL << INS_SIGN_KEYREG_V3) |         \
+   (1UL << INS_SIGN_MSGPACK) | (1UL << INS_SIGN_MSGPACK_STREAM) |       \
+   (1UL << INS_SIGN_GROUP) | (1UL << INS_GET_PUBLIC_KEYS) |             \
+   (1UL << INS_FIND_ACCOUNT) | (1UL << INS_SIGNING_SESSION) |           \
+   (1UL << INS_SET_POLICY) | (1UL << INS_SIGN_PROGRAM) |                \
+   (1UL << INS_SIGN_MULTISIG) | (1UL << INS_GET_SIGNED_TXN) |           \
+   (1UL << INS_SIGN_DELTA) | (1UL << INS_SIGN_RESUMABLE) |              \
+   (1UL << INS_GET_LAST_SIGNATURE) | (1UL << INS_GET_CONFIG) |         \
+   (1UL << INS_SIGN_COMPACT))
+
+#define TARGET_ID_NANOS     0x00
+#define TARGET_ID_NANOX     0x01
+
+/* A short APDU response holds up to 255 bytes. */
+#define PUBLIC_KEYS_MAX     (255 / ALGORAND_PUBLIC_KEY_SIZE)
+/* Room for the strings of a transaction changed by INS_SIGN_DELTA or
+ * sent to INS_SIGN_COMPACT: those of the template, each at its max,
+ * and the new ones of a delta, at most one APDU of them.  The strings
+ * share txn_rx with the decoder, which is larger still, so they take
+ * all of its room at no cost.
+ */
+#define TXN_STRINGS_SIZE    sizeof(tx_decoder_t)
+_Static_assert(TXN_STRINGS_SIZE >= TX_STRINGS_MAX + 255, "txn_strings too small");
+/* Bytes of a SignedTxn returned in one response. */
+#define SIGNED_TXN_CHUNK    255
+/* Signatures of one INS_SIGN_MULTISIG, which fit in a short response. */
+#define MULTISIG_ACCOUNTS_MAX (255 / 64)
+/* Bounds the time spent deriving keys for one INS_FIND_ACCOUNT. */
+#define FIND_ACCOUNT_MAX    256
+/* Accounts are hardened BIP32 indices. */
+#define ACCOUNT_ID_LIMIT    0x80000000
 
 /* The transaction that we might ask the user to approve. */
 txn_t current_txn;
-already_computed_key_t current_pubkey;
 
-/* A buffer for collecting msgpack-encoded transaction via APDUs,
- * as well as for msgpack-encoding transaction prior to signing.
+/* A buffer for collecting msgpack-encoded transaction via APDUs.
+ * The first TX_PREFIX_LEN bytes hold the "TX" domain separator, so
+ * that the validated canonical encoding can be signed in place.
+ * Fixed-layout requests are msgpack-encoded into the same spot.
+ *
+ * On the Nano S, this buffer and the decoder state would not fit
+ * with the rest of the app if it held the 900 bytes it used to, so it
+ * holds 512: larger transactions are streamed instead, and
+ * INS_GET_CONFIG tells the host which to use.
  */
+#define TX_PREFIX_LEN 2
 #if defined(TARGET_NANOX)
-static uint8_t msgpack_buf[2048];
+static uint8_t msgpack_buf[TX_PREFIX_LEN + 2048];
 #else
-static uint8_t msgpack_buf[900];
+static uint8_t msgpack_buf[TX_PREFIX_LEN + 512];
 #endif
 static unsigned int msgpack_next_off;
 
-void
-txn_approve()
+#define MSGPACK_DATA      (&msgpack_buf[TX_PREFIX_LEN])
+#define MSGPACK_DATA_SIZE (sizeof(msgpack_buf) - TX_PREFIX_LEN)
+/* The strings of a streamed transaction are kept there. */
+_Static_assert(MSGPACK_DATA_SIZE >= TX_STRINGS_MAX, "msgpack_buf too small");
+
+/* The ID of the transaction in msgpack_buf, once it is complete. */
+static uint8_t msgpack_txid[32];
+
+/* Chunks are decoded as they arrive; msgpack_buf keeps the bytes
+ * around for signing, and the decoded strings point into it.  The
+ * first pass of a streamed signature copies only the strings there.
+ * The second pass needs no decoding, only the transaction ID check.
+ *
+ * A signature in one pass still needs every byte in msgpack_buf, and
+ * the decoder takes about 500 bytes on 32-bit targets, 408 of them for
+ * its two SHA-512 contexts: the smaller Nano S msgpack_buf pays for
+ * them.  Transactions larger than msgpack_buf are the streamed
+ * signature's job, which never holds them whole.
+ */
+static union {
+  tx_decoder_t txn_decoder;
+  cx_sha512_t txid_hash;
+  uint8_t txn_strings[TXN_STRINGS_SIZE];
+} txn_rx;
+
+/* Whether current_txn, the last transaction decoded for signing, may
+ * serve as the template of INS_SIGN_DELTA.
+ */
+static bool txn_template;
+
+/* Whether a transaction is being uploaded to msgpack_buf by offset
+ * (INS_SIGN_RESUMABLE), msgpack_next_off being the end of the bytes
+ * received so far.  Unlike other requests, such an upload outlives a
+ * transport reset, to be resumed once the link is back.
+ */
+static bool upload_resumable;
+
+/* The last signature released, by transaction ID, so that the host
+ * can fetch it again (INS_GET_LAST_SIGNATURE) if the response is lost
+ * along with the link.  Nothing but a new signature replaces it.  The
+ * signatures of INS_SIGN_MULTISIG are not kept, only their transaction
+ * ID, to tell the host so.
+ */
+static struct {
+  bool valid;
+  bool multisig;
+  uint32_t accountId;
+  uint8_t txid[32];
+  uint8_t sig[64];
+} last_signature;
+
+/* State of a two-pass streamed signature (INS_SIGN_MSGPACK_STREAM),
+ * for transactions that need not fit in msgpack_buf, or of a delegated
+ * LogicSig program (INS_SIGN_PROGRAM), whose "transaction ID" is then
+ * the program hash.
+ */
+#define STREAM_IDLE         0
+#define STREAM_FIRST_PASS   1
+#define STREAM_REVIEW       2
+#define STREAM_APPROVED     3
+#define STREAM_SECOND_PASS  4
+static uint8_t stream_state;
+static uint8_t stream_ins;    // which of the two
+static uint8_t stream_txid[32];
+static uint32_t stream_len;   // program length
+
+/* State of an atomic group signature (INS_SIGN_GROUP): the members
+ * are uploaded and reviewed once together, then sent again one by one
+ * to be signed.
+ */
+#define GROUP_IDLE      0
+#define GROUP_UPLOAD    1
+#define GROUP_REVIEW    2
+#define GROUP_APPROVED  3
+static uint8_t group_state;
+static uint8_t group_index;   // member being received
+static uint8_t group_sign;    // whether it is to be signed
+
+/* A streamed signature and a group are never in progress together. */
+static union {
+  eddsa_stream_t stream_sig;
+  group_t group;
+} session;
+
+/* The signing policy in force, if any, and the one under review.  Any
+ * INS_SET_POLICY request, a transport reset or exiting the app ends
+ * the policy in force.
+ */
+static policy_t policy;
+static policy_t pending_policy;
+
+/* The accounts signing a transaction for several subkeys of the same
+ * multisig account (INS_SIGN_MULTISIG), or none for a single signature.
+ */
+static uint32_t multisig_accounts[MULTISIG_ACCOUNTS_MAX];
+static uint8_t multisig_count;
+
+/* With P1_SIGNED_TXN, INS_SIGN_MSGPACK answers with the canonical
+ * SignedTxn {sgnr, sig, txn} instead of the bare signature.  Only its
+ * header is kept: the transaction itself is read back from msgpack_buf,
+ * in chunks through INS_GET_SIGNED_TXN.
+ */
+static bool signed_txn_requested;
+static struct {
+  uint16_t len;   // 0 when there is none to read
+  uint8_t hdr_len;
+  uint8_t hdr[1 + (5 + 2 + 32) + (4 + 2 + 64) + 4];
+} signed_txn;
+
+/* Drop any streamed signature or group in progress. */
+static void
+stream_reset()
+{
+  stream_state = STREAM_IDLE;
+  group_state = GROUP_IDLE;
+  multisig_count = 0;
+  signed_txn_requested = false;
+  signed_txn.len = 0;
+  txn_template = false;
+  upload_resumable = false;
+  // Also wipes the signing state of a streamed signature.
+  os_memset(&session, 0, sizeof(session));
+}
+
+static void
+stream_approve()
 {
   unsigned int tx = 0;
 
+  eddsa_stream_commit(&session.stream_sig);
+  stream_state = STREAM_APPROVED;
+
+  // Hand back the transaction ID; the host now sends the second pass.
+  os_memmove(G_io_apdu_buffer, stream_txid, sizeof(stream_txid));
+  tx += sizeof(stream_txid);
+  G_io_apdu_buffer[tx++] = 0x90;
+  G_io_apdu_buffer[tx++] = 0x00;
+
+  // Send back the response, do not restart the event loop
+  io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, tx);
+
+  // Display back the original UX
+  ui_idle();
+}
+
+void
+program_approve(bool remember)
+{
+  if (remember) {
+    program_remember(stream_txid, current_txn.accountId);
+  }
+
+  stream_approve();
+}
+
+void
+program_forget_approve(void)
+{
+  program_forget_all();
+
+  G_io_apdu_buffer[0] = 0x90;
+  G_io_apdu_buffer[1] = 0x00;
+
+  // Send back the response, do not restart the event loop
+  io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, 2);
+
+  // Display back the original UX
+  ui_idle();
+}
+
+/* decode_error_response formats the error left in the decoder into
+ * the APDU response, and returns the response length.  Errors are
+ * reported by sending a response longer than the usual ed25519
+ * signature: 65 zero bytes followed by the message.
+ */
+static unsigned int
+decode_error_response(const tx_decoder_t *d)
+{
+  char err[64];
+  char what[16];
+  unsigned int arg = d->err_arg;
+  uint8_t map = d->depth == 0 ? FIELD_COUNT : d->cursor[0] - 1;
+  uint8_t map_first, map_end;
+
+  tx_map_fields(map, &map_first, &map_end);
+  if (d->depth == 0) {
+    snprintf(what, sizeof(what), "field");
+  } else {
+    snprintf(what, sizeof(what), "%s field", tx_fields[map].key);
+  }
+
+  switch (d->err) {
+  case TXDEC_ERR_MAP_HDR:
+    snprintf(err, sizeof(err), "expected map, found %d", arg);
+    break;
+  case TXDEC_ERR_MAP_NONCANON:
+    snprintf(err, sizeof(err), "non-canonical %d-entry map16", arg);
+    break;
+  case TXDEC_ERR_EMPTY_PARAMS:
+    snprintf(err, sizeof(err), "empty %s is not canonical", tx_fields[map].key);
+    break;
+  case TXDEC_ERR_KEY_HDR:
+    snprintf(err, sizeof(err), "expected key, found %d", arg);
+    break;
+  case TXDEC_ERR_KEY_LEN:
+    snprintf(err, sizeof(err), "unknown %d-byte field", arg);
+    break;
+  case TXDEC_ERR_KEY:
+    if (arg == map_first) {
+      snprintf(err, sizeof(err), "unknown %s", what);
+    } else {
+      snprintf(err, sizeof(err), "unknown or out-of-order %s after %s",
+               what, tx_fields[arg-1].key);
+    }
+    break;
+  case TXDEC_ERR_MIXED_TYPES:
+    snprintf(err, sizeof(err), "fields from mixed tx types");
+    break;
+  case TXDEC_ERR_TX_TYPE:
+    snprintf(err, sizeof(err), "unknown tx type %s", d->tbuf);
+    break;
+  case TXDEC_ERR_UINT_HDR:
+    snprintf(err, sizeof(err), "expected u64, found %d", arg);
+    break;
+  case TXDEC_ERR_UINT_ZERO:
+    snprintf(err, sizeof(err), "zero u64 is not canonical");
+    break;
+  case TXDEC_ERR_UINT_NONCANON:
+    snprintf(err, sizeof(err), "non-canonical u64 encoding %d", arg);
+    break;
+  case TXDEC_ERR_BOOL_HDR:
+    snprintf(err, sizeof(err), "expected bool, found %d", arg);
+    break;
+  case TXDEC_ERR_BOOL_FALSE:
+    snprintf(err, sizeof(err), "false bool is not canonical");
+    break;
+  case TXDEC_ERR_STR_HDR:
+    snprintf(err, sizeof(err), "expected string, found %d", arg);
+    break;
+  case TXDEC_ERR_STR_NONCANON:
+    snprintf(err, sizeof(err), "non-canonical %d-byte str8", arg);
+    break;
+  case TXDEC_ERR_STR_EMPTY:
+    snprintf(err, sizeof(err), "empty string is not canonical");
+    break;
+  case TXDEC_ERR_STR_LEN:
+    snprintf(err, sizeof(err), "%d-byte string longer than %d bytes", arg, d->maxlen);
+    break;
+  case TXDEC_ERR_STR_NUL:
+    snprintf(err, sizeof(err), "NUL byte at %d in string", arg);
+    break;
+  case TXDEC_ERR_ARENA_FULL:
+    snprintf(err, sizeof(err), "no room for %d-byte value", arg);
+    break;
+  case TXDEC_ERR_BIN_HDR:
+    snprintf(err, sizeof(err), "expected bin, found %d", arg);
+    break;
+  case TXDEC_ERR_BIN_NONCANON:
+    snprintf(err, sizeof(err), "non-canonical %d-byte bin16", arg);
+    break;
+  case TXDEC_ERR_BIN_EMPTY:
+    snprintf(err, sizeof(err), "empty bin is not canonical");
+    break;
+  case TXDEC_ERR_BIN_LEN:
+    if (d->kind == KIND_BIN_DIGEST || d->kind == KIND_BIN_HASH) {
+      snprintf(err, sizeof(err), "expected <= %d bin bytes, found %d", d->maxlen, arg);
+    } else {
+      snprintf(err, sizeof(err), "expected %u bin bytes, found %d", (unsigned) d->dstlen, arg);
+    }
+    break;
+  case TXDEC_ERR_BIN_ZERO:
+    snprintf(err, sizeof(err), "zero bin is not canonical");
+    break;
+  case TXDEC_ERR_ARR_HDR:
+    snprintf(err, sizeof(err), "expected array, found %d", arg);
+    break;
+  case TXDEC_ERR_ARR_NONCANON:
+    snprintf(err, sizeof(err), "non-canonical %d-element array16", arg);
+    break;
+  case TXDEC_ERR_ARR_EMPTY:
+    snprintf(err, sizeof(err), "empty array is not canonical");
+    break;
+  case TXDEC_ERR_ARR_LEN:
+    snprintf(err, sizeof(err), "expected <= %d array elements, found %d", d->maxlen, arg);
+    break;
+  case TXDEC_ERR_TRAILING:
+    snprintf(err, sizeof(err), "trailing bytes after txn");
+    break;
+  case TXDEC_ERR_TRUNCATED:
+    snprintf(err, sizeof(err), "decode past end");
+    break;
+  case TXDEC_ERR_MISSING_TYPE:
+    snprintf(err, sizeof(err), "missing tx type");
+    break;
+  case TXDEC_ERR_TYPE_MISMATCH:
+    snprintf(err, sizeof(err), "fields do not match tx type");
+    break;
+  case TXDEC_ERR_ARGS_LEN:
+    snprintf(err, sizeof(err), "app args longer than %d bytes in total", APP_ARGS_MAX_LEN);
+    break;
+  default:
+    snprintf(err, sizeof(err), "decode error %d", d->err);
+  }
+
+  int errlen = strlen(err);
+  os_memset(G_io_apdu_buffer, 0, 65);
+  os_memmove(&G_io_apdu_buffer[65], err, errlen);
+  return 65 + errlen;
+}
+
+/* sign_msgpack_buf signs the transaction held in msgpack_buf with the
+ * key of accountId into out, and returns the signature length.
+ */
+static unsigned int
+sign_msgpack_buf(uint32_t accountId, uint8_t *out)
+{
   unsigned int msg_len;
 
   msgpack_buf[0] = 'T';
   msgpack_buf[1] = 'X';
-  msg_len = 2 + tx_encode(&current_txn, msgpack_buf+2, sizeof(msgpack_buf)-2);
+  msg_len = TX_PREFIX_LEN + msgpack_next_off;
 
   PRINTF("Signing message: %.*h\n", msg_len, msgpack_buf);
-  PRINTF("Signing message: accountId:%d\n", current_txn.accountId);
+  PRINTF("Signing message: accountId:%d\n", accountId);
 
   cx_ecfp_private_key_t privateKey;
-  algorand_key_derive(current_txn.accountId, &privateKey);
+  signing_key_get(accountId, &privateKey);
 
   io_seproxyhal_io_heartbeat();
 
-  tx = cx_eddsa_sign(&privateKey,
-                     0, CX_SHA512,
-                     &msgpack_buf[0], msg_len,
-                     NULL, 0,
-                     G_io_apdu_buffer,
-                     6+2*(32+1), // Formerly from cx_compliance_141.c
-                     NULL);
+  unsigned int tx = cx_eddsa_sign(&privateKey,
+                                  0, CX_SHA512,
+                                  &msgpack_buf[0], msg_len,
+                                  NULL, 0,
+                                  out,
+                                  6+2*(32+1), // Formerly from cx_compliance_141.c
+                                  NULL);
+  os_memset(&privateKey, 0, sizeof(privateKey));
 
   io_seproxyhal_io_heartbeat();
 
+  return tx;
+}
+
+static unsigned int
+signed_txn_read(unsigned int off, uint8_t *out, unsigned int max)
+{
+  unsigned int n = 0;
+
+  for (; n < max && off < signed_txn.len; n++, off++) {
+    out[n] = off < signed_txn.hdr_len ? signed_txn.hdr[off]
+                                      : MSGPACK_DATA[off - signed_txn.hdr_len];
+  }
+
+  return n;
+}
+
+/* signed_txn_response turns the signature of current_txn by accountId,
+ * left in the APDU buffer, into the SignedTxn response: its length on
+ * two bytes, then as much of it as fits.  The key that signed is named
+ * in sgnr unless it is the sender's own.
+ */
+static unsigned int
+signed_txn_response(uint32_t accountId)
+{
+  uint8_t publicKey[32];
+  uint8_t *p = signed_txn.hdr;
+  bool rekeyed;
+
+  fetch_public_key(accountId, publicKey);
+  rekeyed = os_memcmp(publicKey, current_txn.sender, sizeof(publicKey)) != 0;
+
+  // Keys in canonical order
+  *p++ = rekeyed ? 0x83 : 0x82;
+  if (rekeyed) {
+    os_memmove(p, "\xa4" "sgnr" "\xc4\x20", 7);
+    os_memmove(p + 7, publicKey, sizeof(publicKey));
+    p += 7 + sizeof(publicKey);
+  }
+  os_memmove(p, "\xa3" "sig" "\xc4\x40", 6);
+  os_memmove(p + 6, G_io_apdu_buffer, 64);
+  p += 6 + 64;
+  os_memmove(p, "\xa3" "txn", 4);
+  p += 4;
+
+  signed_txn.hdr_len = p - signed_txn.hdr;
+  signed_txn.len = signed_txn.hdr_len + msgpack_next_off;
+
+  G_io_apdu_buffer[0] = signed_txn.len >> 8;
+  G_io_apdu_buffer[1] = signed_txn.len;
+  return 2 + signed_txn_read(0, &G_io_apdu_buffer[2], SIGNED_TXN_CHUNK - 2);
+}
+
+static void
+remember_signature(const uint8_t *txid, uint32_t accountId, const uint8_t *sig)
+{
+  last_signature.valid = true;
+  last_signature.multisig = false;
+  last_signature.accountId = accountId;
+  os_memmove(last_signature.txid, txid, sizeof(last_signature.txid));
+  os_memmove(last_signature.sig, sig, sizeof(last_signature.sig));
+
+  // The user signed with this account: keep its key across a power loss.
+  pubkey_cache_save();
+}
+
+/* msgpack_buf_done finishes decoding the transaction uploaded to
+ * msgpack_buf, and returns the length of the response to send right
+ * away: a decoding error, or the signature under the signing policy.
+ * It returns 0 once the transaction is shown for review instead.
+ */
+static unsigned int
+msgpack_buf_done(void)
+{
+  if (tx_decoder_finish(&txn_rx.txn_decoder, &current_txn, msgpack_txid) != TXDEC_OK) {
+    return decode_error_response(&txn_rx.txn_decoder);
+  }
+
+  PRINTF("Transaction ID: %.*h\n", 32, msgpack_txid);
+  txn_template = true;
+
+  if (multisig_count == 0 && policy_matches(&policy, &current_txn)) {
+    // Approved beforehand, along with the policy
+    unsigned int tx = sign_msgpack_buf(current_txn.accountId, G_io_apdu_buffer);
+    remember_signature(msgpack_txid, current_txn.accountId, G_io_apdu_buffer);
+    if (signed_txn_requested) {
+      tx = signed_txn_response(current_txn.accountId);
+    }
+    return tx;
+  }
+
+  ui_txn_signers(msgpack_txid, multisig_accounts, multisig_count);
+  return 0;
+}
+
+void
+txn_approve()
+{
+  unsigned int tx = 0;
+
+  if (stream_state == STREAM_REVIEW) {
+    stream_approve();
+    return;
+  }
+
+  if (multisig_count > 0) {
+    for (int i = 0; i < multisig_count; i++) {
+      tx += sign_msgpack_buf(multisig_accounts[i], &G_io_apdu_buffer[tx]);
+    }
+    multisig_count = 0;
+    last_signature.valid = true;
+    last_signature.multisig = true;
+    os_memmove(last_signature.txid, msgpack_txid, sizeof(last_signature.txid));
+    pubkey_cache_save();
+  } else {
+    tx = sign_msgpack_buf(current_txn.accountId, G_io_apdu_buffer);
+    remember_signature(msgpack_txid, current_txn.accountId, G_io_apdu_buffer);
+    if (signed_txn_requested) {
+      tx = signed_txn_response(current_txn.accountId);
+    }
+  }
+
   G_io_apdu_buffer[tx++] = 0x90;
   G_io_apdu_buffer[tx++] = 0x00;
 
@@ -88,6 +591,41 @@ txn_approve()
   ui_idle();
 }
 
+void
+group_approve()
+{
+  unsigned int tx = 0;
+
+  group_state = GROUP_APPROVED;
+
+  // Hand back the group ID; the host now sends the members to sign.
+  os_memmove(G_io_apdu_buffer, session.group.group_id, sizeof(session.group.group_id));
+  tx += sizeof(session.group.group_id);
+  G_io_apdu_buffer[tx++] = 0x90;
+  G_io_apdu_buffer[tx++] = 0x00;
+
+  // Send back the response, do not restart the event loop
+  io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, tx);
+
+  // Display back the original UX
+  ui_idle();
+}
+
+void
+policy_approve()
+{
+  policy = pending_policy;
+
+  G_io_apdu_buffer[0] = 0x90;
+  G_io_apdu_buffer[1] = 0x00;
+
+  // Send back the response, do not restart the event loop
+  io_exchange(CHANNEL_APDU | IO_RETURN_AFTER_TX, 2);
+
+  // Display back the original UX
+  ui_idle();
+}
+
 void address_approve()
 {
   unsigned int tx = ALGORAND_PUBLIC_KEY_SIZE;
@@ -105,6 +643,8 @@ void address_approve()
 void
 user_approval_denied()
 {
+  stream_reset();
+
   G_io_apdu_buffer[0] = 0x69;
   G_io_apdu_buffer[1] = 0x85;
 
@@ -115,6 +655,12 @@ user_approval_denied()
   ui_idle();
 }
 
+static uint64_t
+u64be(const uint8_t *p)
+{
+  return ((uint64_t) U4BE(p, 0) << 32) | U4BE(p, 4);
+}
+
 static void
 copy_and_advance(void *dst, uint8_t **p, size_t len)
 {
@@ -122,10 +668,71 @@ copy_and_advance(void *dst, uint8_t **p, size_t len)
   *p += len;
 }
 
+/* Legacy requests carry strings as NUL-padded fixed-size fields; the
+ * view points into the APDU buffer until the transaction is encoded.
+ */
+static void
+view_and_advance(tx_view_t *v, uint8_t **p, size_t len)
+{
+  v->off = *p - G_io_apdu_buffer;
+  v->len = strnlen((const char *) *p, len);
+  *p += len;
+}
+
+/* Encode current_txn into msgpack_buf and decode it again, for its ID
+ * in msgpack_txid
+ * and so that its views point into msgpack_buf instead of the APDU
+ * buffer (legacy requests) or txn_strings.
+ */
+static void
+reencode_txn(void)
+{
+  tx_decoder_t *d = &txn_rx.txn_decoder;
+
+  msgpack_next_off = tx_encode(&current_txn, MSGPACK_DATA, MSGPACK_DATA_SIZE);
+  if (msgpack_next_off == 0) {
+    THROW(0x6A80);
+  }
+  tx_decoder_init(d, &current_txn, MSGPACK_DATA);
+  tx_decoder_feed(d, &current_txn, MSGPACK_DATA, msgpack_next_off);
+  if (tx_decoder_finish(d, &current_txn, msgpack_txid) != TXDEC_OK) {
+    THROW(0x6A80);
+  }
+}
+
+/* rebuilt_txn_done signs or shows for review current_txn, once built
+ * from a delta or a compact encoding, as msgpack_buf_done does for an
+ * upload.
+ */
+static unsigned int
+rebuilt_txn_done(void)
+{
+  reencode_txn();
+  txn_template = true;
+
+  PRINTF("Transaction ID: %.*h\n", 32, msgpack_txid);
+
+  if (policy_matches(&policy, &current_txn)) {
+    unsigned int tx = sign_msgpack_buf(current_txn.accountId, G_io_apdu_buffer);
+    remember_signature(msgpack_txid, current_txn.accountId, G_io_apdu_buffer);
+    if (signed_txn_requested) {
+      tx = signed_txn_response(current_txn.accountId);
+    }
+    return tx;
+  }
+
+  ui_txn(msgpack_txid);
+  return 0;
+}
+
 void init_globals(){
-  memset(&current_txn, 0, sizeof(current_txn));
-  memset(&current_pubkey, 0, sizeof(current_pubkey));
+  // A resumable upload keeps its transaction across a transport reset.
+  if (!upload_resumable) {
+    memset(&current_txn, 0, sizeof(current_txn));
+  }
+  pubkey_cache_load();
   fetch_public_key(0, text);
+  pubkey_cache_save();
 }
 
 static void
@@ -135,7 +742,10 @@ algorand_main(void)
   volatile unsigned int tx = 0;
   volatile unsigned int flags = 0;
 
-  msgpack_next_off = 0;
+  if (!upload_resumable) {
+    msgpack_next_off = 0;
+    tx_decoder_init(&txn_rx.txn_decoder, &current_txn, MSGPACK_DATA);
+  }
 
   // DESIGN NOTE: the bootloader ignores the way APDU are fetched. The only
   // goal is to retrieve APDU.
@@ -171,6 +781,7 @@ algorand_main(void)
         case INS_SIGN_PAYMENT_V2:
         case INS_SIGN_PAYMENT_V3:
         {
+          stream_reset();
           os_memset(&current_txn, 0, sizeof(current_txn));
           uint8_t *p;
           if (ins == INS_SIGN_PAYMENT_V2) {
@@ -180,23 +791,27 @@ algorand_main(void)
           }
 
           current_txn.type = PAYMENT;
+          current_txn.view_base = G_io_apdu_buffer;
           copy_and_advance( current_txn.sender,           &p, 32);
           copy_and_advance(&current_txn.fee,              &p, 8);
           copy_and_advance(&current_txn.firstValid,       &p, 8);
           copy_and_advance(&current_txn.lastValid,        &p, 8);
-          copy_and_advance( current_txn.genesisID,        &p, 32);
+          view_and_advance(&current_txn.genesisID,        &p, 32);
           copy_and_advance( current_txn.genesisHash,      &p, 32);
           copy_and_advance( current_txn.payment.receiver, &p, 32);
           copy_and_advance(&current_txn.payment.amount,   &p, 8);
           copy_and_advance( current_txn.payment.close,    &p, 32);
 
-          ui_txn();
+          reencode_txn();
+
+          ui_txn(msgpack_txid);
           flags |= IO_ASYNCH_REPLY;
         } break;
 
         case INS_SIGN_KEYREG_V2:
         case INS_SIGN_KEYREG_V3:
         {
+          stream_reset();
           os_memset(&current_txn, 0, sizeof(current_txn));
           uint8_t *p;
           if (ins == INS_SIGN_KEYREG_V2) {
@@ -206,28 +821,53 @@ algorand_main(void)
           }
 
           current_txn.type = KEYREG;
+          current_txn.view_base = G_io_apdu_buffer;
           copy_and_advance( current_txn.sender,        &p, 32);
           copy_and_advance(&current_txn.fee,           &p, 8);
           copy_and_advance(&current_txn.firstValid,    &p, 8);
           copy_and_advance(&current_txn.lastValid,     &p, 8);
-          copy_and_advance( current_txn.genesisID,     &p, 32);
+          view_and_advance(&current_txn.genesisID,     &p, 32);
           copy_and_advance( current_txn.genesisHash,   &p, 32);
           copy_and_advance( current_txn.keyreg.votepk, &p, 32);
           copy_and_advance( current_txn.keyreg.vrfpk,  &p, 32);
 
-          ui_txn();
+          reencode_txn();
+
+          ui_txn(msgpack_txid);
           flags |= IO_ASYNCH_REPLY;
         } break;
 
-        case INS_SIGN_MSGPACK: {
+        case INS_SIGN_MSGPACK:
+        case INS_SIGN_MULTISIG: {
           uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
           uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
 
           switch (G_io_apdu_buffer[OFFSET_P1] & 0x80) {
           case P1_FIRST:
+            stream_reset();
             os_memset(&current_txn, 0, sizeof(current_txn));
-            current_txn.accountId = 0;
-            if (G_io_apdu_buffer[OFFSET_P1] & P1_WITH_ACCOUNT_ID) {
+            tx_decoder_init(&txn_rx.txn_decoder, &current_txn, MSGPACK_DATA);
+            if (ins == INS_SIGN_MULTISIG) {
+              uint8_t count = lc > 0 ? cdata[0] : 0;
+              if (lc < 1 + count * sizeof(uint32_t)) {
+                THROW(0x6700);
+              }
+              if (count == 0 || count > MULTISIG_ACCOUNTS_MAX) {
+                THROW(0x6A84);
+              }
+              for (int i = 0; i < count; i++) {
+                multisig_accounts[i] = U4BE(cdata, 1 + i * sizeof(uint32_t));
+                for (int j = 0; j < i; j++) {
+                  if (multisig_accounts[j] == multisig_accounts[i]) {
+                    THROW(0x6A80);
+                  }
+                }
+              }
+              multisig_count = count;
+              current_txn.accountId = multisig_accounts[0];
+              cdata += 1 + count * sizeof(uint32_t);
+              lc -= 1 + count * sizeof(uint32_t);
+            } else if (G_io_apdu_buffer[OFFSET_P1] & P1_WITH_ACCOUNT_ID) {
               if (lc < sizeof(uint32_t)) {
                 THROW(0x6700);
               }
@@ -235,6 +875,8 @@ algorand_main(void)
               cdata += sizeof(uint32_t);
               lc -= sizeof(uint32_t);
             }
+            signed_txn_requested = ins == INS_SIGN_MSGPACK &&
+                                   (G_io_apdu_buffer[OFFSET_P1] & P1_SIGNED_TXN);
             msgpack_next_off = 0;
             break;
           case P1_MORE:
@@ -243,37 +885,444 @@ algorand_main(void)
             THROW(0x6B00);
           }
 
-          if (msgpack_next_off + lc > sizeof(msgpack_buf)) {
+          if (msgpack_next_off + lc > MSGPACK_DATA_SIZE) {
             THROW(0x6700);
           }
 
-          os_memmove(&msgpack_buf[msgpack_next_off], cdata, lc);
+          os_memmove(&MSGPACK_DATA[msgpack_next_off], cdata, lc);
           msgpack_next_off += lc;
 
+          /* A decoding error is remembered by the decoder and
+           * reported once the last chunk has arrived.
+           */
+          tx_decoder_feed(&txn_rx.txn_decoder, &current_txn, cdata, lc);
+
           switch (G_io_apdu_buffer[OFFSET_P2]) {
           case P2_LAST:
-            {
-              char *err = tx_decode(msgpack_buf, msgpack_next_off, &current_txn);
-              if (err != NULL) {
-                /* Return error by sending a response length longer than
-                 * the usual ed25519 signature.
-                 */
-                int errlen = strlen(err);
-                os_memset(G_io_apdu_buffer, 0, 65);
-                os_memmove(&G_io_apdu_buffer[65], err, errlen);
-                tx = 65 + errlen;
-                THROW(0x9000);
+            tx = msgpack_buf_done();
+            if (tx > 0) {
+              THROW(0x9000);
+            }
+            flags |= IO_ASYNCH_REPLY;
+            break;
+          case P2_MORE:
+            THROW(0x9000);
+          default:
+            THROW(0x6B00);
+          }
+        } break;
+
+        case INS_SIGN_RESUMABLE: {
+          uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
+          uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
+          uint8_t p1 = G_io_apdu_buffer[OFFSET_P1];
+          unsigned int off;
+
+          if (G_io_apdu_buffer[OFFSET_P2] != P2_LAST &&
+              G_io_apdu_buffer[OFFSET_P2] != P2_MORE) {
+            THROW(0x6B00);
+          }
+
+          /* {CRC16 of INS, P1, P2 and the rest} {offset} ...  The header
+           * is covered too, so that a corrupted P1 or P2 cannot turn a
+           * chunk into a first or last one.
+           */
+          if (lc < 2 * sizeof(uint16_t)) {
+            THROW(0x6700);
+          }
+          uint16_t crc = cx_crc16_update(0xFFFF, &G_io_apdu_buffer[OFFSET_INS], 3);
+          if (U2BE(cdata, 0) != cx_crc16_update(crc, cdata + 2, lc - 2)) {
+            // A corrupted chunk leaves the upload as it was.
+            THROW(0x6A80);
+          }
+          off = U2BE(cdata, 2);
+          cdata += 2 * sizeof(uint16_t);
+          lc -= 2 * sizeof(uint16_t);
+
+          if ((p1 & 0x80) == P1_FIRST) {
+            if (off != 0) {
+              THROW(0x6A80);
+            }
+            stream_reset();
+            os_memset(&current_txn, 0, sizeof(current_txn));
+            tx_decoder_init(&txn_rx.txn_decoder, &current_txn, MSGPACK_DATA);
+            if (p1 & P1_WITH_ACCOUNT_ID) {
+              if (lc < sizeof(uint32_t)) {
+                THROW(0x6700);
               }
+              current_txn.accountId = U4BE(cdata, 0);
+              cdata += sizeof(uint32_t);
+              lc -= sizeof(uint32_t);
+            }
+            signed_txn_requested = p1 & P1_SIGNED_TXN;
+            msgpack_next_off = 0;
+            upload_resumable = true;
+          } else if (!upload_resumable) {
+            THROW(0x6985);
+          }
 
-              ui_txn();
+          /* Only the chunk that starts where the bytes received so far
+           * end is taken.  Others are duplicates, or follow a lost
+           * chunk, which the host sends again from the offset in the
+           * response.
+           */
+          if (off == msgpack_next_off) {
+            if (msgpack_next_off + lc > MSGPACK_DATA_SIZE) {
+              THROW(0x6700);
+            }
+            os_memmove(&MSGPACK_DATA[msgpack_next_off], cdata, lc);
+            msgpack_next_off += lc;
+            tx_decoder_feed(&txn_rx.txn_decoder, &current_txn, cdata, lc);
+
+            if (G_io_apdu_buffer[OFFSET_P2] == P2_LAST) {
+              upload_resumable = false;
+              tx = msgpack_buf_done();
+              if (tx > 0) {
+                THROW(0x9000);
+              }
               flags |= IO_ASYNCH_REPLY;
+              break;
+            }
+          }
+
+          G_io_apdu_buffer[0] = msgpack_next_off >> 8;
+          G_io_apdu_buffer[1] = msgpack_next_off;
+          tx = 2;
+          THROW(0x9000);
+        } break;
+
+        case INS_SIGN_DELTA: {
+          uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
+          uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
+          uint8_t p1 = G_io_apdu_buffer[OFFSET_P1];
+
+          if (!txn_template) {
+            THROW(0x6985);
+          }
+          stream_reset();
+
+          if (p1 & P1_WITH_ACCOUNT_ID) {
+            if (lc < sizeof(uint32_t)) {
+              THROW(0x6700);
             }
+            current_txn.accountId = U4BE(cdata, 0);
+            cdata += sizeof(uint32_t);
+            lc -= sizeof(uint32_t);
+          }
+          signed_txn_requested = p1 & P1_SIGNED_TXN;
+
+          // The template is lost once a delta starts applying.
+          if (!tx_apply_delta(&current_txn, cdata, lc, txn_rx.txn_strings,
+                              sizeof(txn_rx.txn_strings))) {
+            THROW(0x6A80);
+          }
+          tx = rebuilt_txn_done();
+          if (tx > 0) {
+            THROW(0x9000);
+          }
+          flags |= IO_ASYNCH_REPLY;
+        } break;
+
+        case INS_SIGN_COMPACT: {
+          uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
+          uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
+          uint8_t p1 = G_io_apdu_buffer[OFFSET_P1];
+
+          stream_reset();
+          os_memset(&current_txn, 0, sizeof(current_txn));
+          if (p1 & P1_WITH_ACCOUNT_ID) {
+            if (lc < sizeof(uint32_t)) {
+              THROW(0x6700);
+            }
+            current_txn.accountId = U4BE(cdata, 0);
+            cdata += sizeof(uint32_t);
+            lc -= sizeof(uint32_t);
+          }
+          signed_txn_requested = p1 & P1_SIGNED_TXN;
+
+          if (!tx_decode_compact(&current_txn, cdata, lc, txn_rx.txn_strings,
+                                 sizeof(txn_rx.txn_strings))) {
+            THROW(0x6A80);
+          }
+          tx = rebuilt_txn_done();
+          if (tx > 0) {
+            THROW(0x9000);
+          }
+          flags |= IO_ASYNCH_REPLY;
+        } break;
+
+        case INS_SIGN_MSGPACK_STREAM:
+        case INS_SIGN_PROGRAM: {
+          uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
+          uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
+          uint8_t p1 = G_io_apdu_buffer[OFFSET_P1];
+          const char *prefix = ins == INS_SIGN_PROGRAM ? "Program" : "TX";
+          size_t prefix_len = strlen(prefix);
+
+          if (ins == INS_SIGN_PROGRAM && p1 == P1_FORGET_PROGRAMS) {
+            ui_program_forget();
+            flags |= IO_ASYNCH_REPLY;
             break;
-          case P2_MORE:
+          }
+
+          if (G_io_apdu_buffer[OFFSET_P2] != P2_LAST &&
+              G_io_apdu_buffer[OFFSET_P2] != P2_MORE) {
+            THROW(0x6B00);
+          }
+
+          if (p1 & P1_SECOND_PASS) {
+            /* Second pass: the approved transaction is sent again,
+             * hashed for the signature and checked against the
+             * transaction ID computed during the first pass.
+             */
+            if ((p1 & 0x80) == P1_FIRST) {
+              if ((stream_state != STREAM_APPROVED &&
+                   stream_state != STREAM_SECOND_PASS) ||
+                  stream_ins != ins) {
+                THROW(0x6985);
+              }
+
+              eddsa_stream_second_pass(&session.stream_sig);
+              eddsa_stream_update(&session.stream_sig, (uint8_t *) prefix, prefix_len);
+
+              sha512_256_init(&txn_rx.txid_hash);
+              cx_hash(&txn_rx.txid_hash.header, 0, (uint8_t *) prefix, prefix_len, NULL, 0);
+              stream_state = STREAM_SECOND_PASS;
+            } else if (stream_state != STREAM_SECOND_PASS || stream_ins != ins) {
+              THROW(0x6985);
+            }
+
+            eddsa_stream_update(&session.stream_sig, cdata, lc);
+            cx_hash(&txn_rx.txid_hash.header, 0, cdata, lc, NULL, 0);
+
+            if (G_io_apdu_buffer[OFFSET_P2] == P2_MORE) {
+              THROW(0x9000);
+            }
+
+            uint8_t hash[64];
+            cx_hash(&txn_rx.txid_hash.header, CX_LAST, NULL, 0, hash, sizeof(hash));
+            if (os_memcmp(hash, stream_txid, sizeof(stream_txid)) != 0) {
+              // Never release a signature over a different message
+              stream_reset();
+              THROW(0x6A80);
+            }
+
+            eddsa_stream_sign(&session.stream_sig, G_io_apdu_buffer);
+            remember_signature(stream_txid, current_txn.accountId, G_io_apdu_buffer);
+            stream_reset();
+            tx = 64;
             THROW(0x9000);
-          default:
+          }
+
+          /* First pass: decode for review, or hash a program, while
+           * hashing for the signature nonce.
+           */
+          if ((p1 & 0x80) == P1_FIRST) {
+            uint32_t accountId = 0;
+
+            stream_reset();
+            if (p1 & P1_WITH_ACCOUNT_ID) {
+              if (lc < sizeof(uint32_t)) {
+                THROW(0x6700);
+              }
+              accountId = U4BE(cdata, 0);
+              cdata += sizeof(uint32_t);
+              lc -= sizeof(uint32_t);
+            }
+
+            if (ins == INS_SIGN_PROGRAM) {
+              sha512_256_init(&txn_rx.txid_hash);
+              cx_hash(&txn_rx.txid_hash.header, 0, (uint8_t *) prefix, prefix_len, NULL, 0);
+              stream_len = 0;
+            } else {
+              os_memset(&current_txn, 0, sizeof(current_txn));
+              /* Nothing but the decoded strings is kept from the
+               * first pass, so msgpack_buf holds them instead.
+               */
+              tx_decoder_init_arena(&txn_rx.txn_decoder, &current_txn,
+                                    MSGPACK_DATA, MSGPACK_DATA_SIZE);
+            }
+            current_txn.accountId = accountId;
+
+            eddsa_stream_init(&session.stream_sig, accountId);
+            eddsa_stream_update(&session.stream_sig, (uint8_t *) prefix, prefix_len);
+            stream_ins = ins;
+            stream_state = STREAM_FIRST_PASS;
+          } else if (stream_state != STREAM_FIRST_PASS || stream_ins != ins) {
+            THROW(0x6985);
+          }
+
+          eddsa_stream_update(&session.stream_sig, cdata, lc);
+          if (ins == INS_SIGN_PROGRAM) {
+            cx_hash(&txn_rx.txid_hash.header, 0, cdata, lc, NULL, 0);
+            stream_len += lc;
+          } else {
+            tx_decoder_feed(&txn_rx.txn_decoder, &current_txn, cdata, lc);
+          }
+
+          if (G_io_apdu_buffer[OFFSET_P2] == P2_MORE) {
+            THROW(0x9000);
+          }
+
+          if (ins == INS_SIGN_PROGRAM) {
+            uint8_t hash[64];
+            cx_hash(&txn_rx.txid_hash.header, CX_LAST, NULL, 0, hash, sizeof(hash));
+            os_memmove(stream_txid, hash, sizeof(stream_txid));
+            stream_state = STREAM_REVIEW;
+
+            // The user chose to delegate this program from this
+            // account without review.
+            if (program_is_remembered(stream_txid, current_txn.accountId)) {
+              eddsa_stream_commit(&session.stream_sig);
+              stream_state = STREAM_APPROVED;
+              os_memmove(G_io_apdu_buffer, stream_txid, sizeof(stream_txid));
+              tx = sizeof(stream_txid);
+              THROW(0x9000);
+            }
+
+            ui_program(stream_len, stream_txid, current_txn.accountId);
+            flags |= IO_ASYNCH_REPLY;
+            break;
+          }
+
+          if (tx_decoder_finish(&txn_rx.txn_decoder, &current_txn, stream_txid) != TXDEC_OK) {
+            stream_reset();
+            tx = decode_error_response(&txn_rx.txn_decoder);
+            THROW(0x9000);
+          }
+
+          stream_state = STREAM_REVIEW;
+          ui_txn(stream_txid);
+          flags |= IO_ASYNCH_REPLY;
+        } break;
+
+        case INS_SIGN_GROUP: {
+          uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
+          uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
+          uint8_t p1 = G_io_apdu_buffer[OFFSET_P1];
+
+          if (G_io_apdu_buffer[OFFSET_P2] != P2_LAST &&
+              G_io_apdu_buffer[OFFSET_P2] != P2_MORE) {
             THROW(0x6B00);
           }
+
+          /* The first chunk of each member starts with its index in
+           * the group.  The members are uploaded in group order, each
+           * along with the group size, and once the group is approved
+           * those to sign are sent again, in any order.
+           */
+          if ((p1 & 0x80) == P1_FIRST) {
+            if (lc < 1) {
+              THROW(0x6700);
+            }
+            group_index = cdata[0];
+            cdata++;
+            lc--;
+            msgpack_next_off = 0;
+
+            if (p1 & P1_SECOND_PASS) {
+              if (group_state != GROUP_APPROVED) {
+                THROW(0x6985);
+              }
+            } else {
+              if (lc < 1) {
+                THROW(0x6700);
+              }
+              uint8_t size = cdata[0];
+              cdata++;
+              lc--;
+
+              if (group_index == 0) {
+                stream_reset();
+                if (!group_start(&session.group, size)) {
+                  THROW(0x6A84);
+                }
+                group_state = GROUP_UPLOAD;
+              } else if (group_state != GROUP_UPLOAD ||
+                         group_index != session.group.count ||
+                         size != session.group.size) {
+                stream_reset();
+                THROW(0x6A80);
+              }
+
+              os_memset(&current_txn, 0, sizeof(current_txn));
+              tx_decoder_init(&txn_rx.txn_decoder, &current_txn, MSGPACK_DATA);
+              // Only the members sent with an account are signed.
+              group_sign = 0;
+              if (p1 & P1_WITH_ACCOUNT_ID) {
+                if (lc < sizeof(uint32_t)) {
+                  THROW(0x6700);
+                }
+                current_txn.accountId = U4BE(cdata, 0);
+                cdata += sizeof(uint32_t);
+                lc -= sizeof(uint32_t);
+                group_sign = 1;
+              }
+            }
+          } else if (group_state != ((p1 & P1_SECOND_PASS) ? GROUP_APPROVED : GROUP_UPLOAD)) {
+            THROW(0x6985);
+          }
+
+          if (msgpack_next_off + lc > MSGPACK_DATA_SIZE) {
+            THROW(0x6700);
+          }
+
+          os_memmove(&MSGPACK_DATA[msgpack_next_off], cdata, lc);
+          msgpack_next_off += lc;
+          if (!(p1 & P1_SECOND_PASS)) {
+            tx_decoder_feed(&txn_rx.txn_decoder, &current_txn, cdata, lc);
+          }
+
+          if (G_io_apdu_buffer[OFFSET_P2] == P2_MORE) {
+            THROW(0x9000);
+          }
+
+          if (p1 & P1_SECOND_PASS) {
+            const group_member_t *m;
+            uint8_t hash[64];
+
+            msgpack_buf[0] = 'T';
+            msgpack_buf[1] = 'X';
+            sha512_256_init(&txn_rx.txid_hash);
+            cx_hash(&txn_rx.txid_hash.header, CX_LAST, msgpack_buf,
+                    TX_PREFIX_LEN + msgpack_next_off, hash, sizeof(hash));
+
+            // Never sign anything but an approved member
+            m = group_member_to_sign(&session.group, group_index, hash);
+            if (m == NULL) {
+              THROW(0x6A80);
+            }
+
+            tx = sign_msgpack_buf(m->accountId, G_io_apdu_buffer);
+            remember_signature(hash, m->accountId, G_io_apdu_buffer);
+            THROW(0x9000);
+          }
+
+          uint8_t txid[32];
+          if (tx_decoder_finish(&txn_rx.txn_decoder, &current_txn, txid) != TXDEC_OK) {
+            stream_reset();
+            tx = decode_error_response(&txn_rx.txn_decoder);
+            THROW(0x9000);
+          }
+
+          if (!group_add(&session.group, &current_txn, MSGPACK_DATA, msgpack_next_off,
+                         txn_rx.txn_decoder.grp_off, txid, group_sign)) {
+            stream_reset();
+            THROW(0x6A80);
+          }
+
+          if (session.group.count < session.group.size) {
+            THROW(0x9000);
+          }
+
+          if (!group_finish(&session.group)) {
+            stream_reset();
+            THROW(0x6A80);
+          }
+
+          group_state = GROUP_REVIEW;
+          ui_group(&session.group);
+          flags |= IO_ASYNCH_REPLY;
         } break;
 
         case INS_GET_PUBLIC_KEY: {
@@ -297,7 +1346,9 @@ algorand_main(void)
           fetch_public_key(accountId, G_io_apdu_buffer);
 
           if(user_approval_required){
-            checksummed_addr(G_io_apdu_buffer, checksummed);
+            fetch_address(accountId, checksummed);
+            // The user asked for this account: keep its key.
+            pubkey_cache_save();
             ui_text_put(checksummed);
             ui_address_approval();
             flags |= IO_ASYNCH_REPLY;
@@ -309,6 +1360,194 @@ algorand_main(void)
           
         } break;
 
+        case INS_GET_PUBLIC_KEYS: {
+          uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
+          uint32_t first;
+          uint8_t count = PUBLIC_KEYS_MAX;
+
+          // The count is optional: as many keys as fit by default.
+          if (rx <= OFFSET_LC || (lc != sizeof(uint32_t) && lc != sizeof(uint32_t) + 1)) {
+            THROW(0x6a85);
+          }
+          first = U4BE(G_io_apdu_buffer, OFFSET_CDATA);
+          if (lc == sizeof(uint32_t) + 1 &&
+              G_io_apdu_buffer[OFFSET_CDATA + sizeof(uint32_t)] < count) {
+            count = G_io_apdu_buffer[OFFSET_CDATA + sizeof(uint32_t)];
+          }
+          if (first >= ACCOUNT_ID_LIMIT || ACCOUNT_ID_LIMIT - first < count) {
+            THROW(0x6A80);
+          }
+
+          fetch_public_keys(first, count, G_io_apdu_buffer);
+          tx = count * ALGORAND_PUBLIC_KEY_SIZE;
+          THROW(0x9000);
+        } break;
+
+        case INS_GET_SIGNED_TXN: {
+          uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
+          unsigned int off;
+
+          if (signed_txn.len == 0) {
+            THROW(0x6985);
+          }
+          if (lc != sizeof(uint16_t)) {
+            THROW(0x6700);
+          }
+          off = U2BE(G_io_apdu_buffer, OFFSET_CDATA);
+          if (off > signed_txn.len) {
+            THROW(0x6A80);
+          }
+
+          tx = signed_txn_read(off, G_io_apdu_buffer, SIGNED_TXN_CHUNK);
+          THROW(0x9000);
+        } break;
+
+        case INS_GET_LAST_SIGNATURE: {
+          uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
+          uint8_t lc = G_io_apdu_buffer[OFFSET_LC];
+          uint32_t accountId = 0;
+
+          if (G_io_apdu_buffer[OFFSET_P1] & P1_WITH_ACCOUNT_ID) {
+            if (lc != 32 + sizeof(uint32_t)) {
+              THROW(0x6700);
+            }
+            accountId = U4BE(cdata, 32);
+          } else if (lc != 32) {
+            THROW(0x6700);
+          }
+
+          if (!last_signature.valid || os_memcmp(last_signature.txid, cdata, 32) != 0) {
+            THROW(0x6A88);
+          }
+          if (last_signature.multisig) {
+            // Not kept: the transaction must be signed again.
+            THROW(0x6985);
+          }
+          if (last_signature.accountId != accountId) {
+            THROW(0x6A88);
+          }
+
+          os_memmove(G_io_apdu_buffer, last_signature.sig, sizeof(last_signature.sig));
+          tx = sizeof(last_signature.sig);
+          THROW(0x9000);
+        } break;
+
+        case INS_GET_CONFIG: {
+          uint8_t *p = G_io_apdu_buffer;
+          uint32_t ins_bits = SUPPORTED_INS;
+          uint16_t buf_size = MSGPACK_DATA_SIZE;
+          uint16_t io_size = IO_SEPROXYHAL_BUFFER_SIZE_B;
+
+          *p++ = APPVERSION_M;
+          *p++ = APPVERSION_N;
+          *p++ = APPVERSION_P;
+#if defined(TARGET_NANOX)
+          *p++ = TARGET_ID_NANOX;
+#else
+          *p++ = TARGET_ID_NANOS;
+#endif
+          *p++ = ins_bits >> 24;
+          *p++ = ins_bits >> 16;
+          *p++ = ins_bits >> 8;
+          *p++ = ins_bits;
+          *p++ = buf_size >> 8;
+          *p++ = buf_size;
+          *p++ = io_size >> 8;
+          *p++ = io_size;
+          // The payload of a short APDU
+          *p++ = 255;
+          *p++ = NOTE_PREVIEW_LEN;
+          *p++ = GROUP_MAX_SIZE;
+          *p++ = MULTISIG_ACCOUNTS_MAX;
+          *p++ = PUBLIC_KEYS_MAX;
+          *p++ = PROGRAM_CACHE_SIZE;
+
+          tx = p - G_io_apdu_buffer;
+          THROW(0x9000);
+        } break;
+
+        case INS_FIND_ACCOUNT: {
+          uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
+          uint32_t first, count, accountId;
+
+          if (rx <= OFFSET_LC ||
+              G_io_apdu_buffer[OFFSET_LC] != ALGORAND_PUBLIC_KEY_SIZE + 2 * sizeof(uint32_t)) {
+            THROW(0x6a85);
+          }
+          first = U4BE(cdata, ALGORAND_PUBLIC_KEY_SIZE);
+          count = U4BE(cdata, ALGORAND_PUBLIC_KEY_SIZE + sizeof(uint32_t));
+          if (count > FIND_ACCOUNT_MAX ||
+              first >= ACCOUNT_ID_LIMIT || ACCOUNT_ID_LIMIT - first < count) {
+            THROW(0x6A80);
+          }
+
+          if (!find_account(cdata, first, count, &accountId)) {
+            THROW(0x6A88);
+          }
+
+          G_io_apdu_buffer[0] = accountId >> 24;
+          G_io_apdu_buffer[1] = accountId >> 16;
+          G_io_apdu_buffer[2] = accountId >> 8;
+          G_io_apdu_buffer[3] = accountId;
+          tx = sizeof(uint32_t);
+          THROW(0x9000);
+        } break;
+
+        case INS_SIGNING_SESSION:
+          switch (G_io_apdu_buffer[OFFSET_P1]) {
+          case P1_SESSION_START:
+            signing_key_session(true);
+            break;
+          case P1_SESSION_END:
+            signing_key_session(false);
+            break;
+          default:
+            THROW(0x6B00);
+          }
+          THROW(0x9000);
+          break;
+
+        case INS_SET_POLICY: {
+          uint8_t *cdata = &G_io_apdu_buffer[OFFSET_CDATA];
+          uint8_t kind = G_io_apdu_buffer[OFFSET_P1];
+          unsigned int len = sizeof(uint32_t) + sizeof(uint64_t);
+
+          os_memset(&policy, 0, sizeof(policy));
+          if (kind == POLICY_NONE) {
+            THROW(0x9000);
+          }
+          if (kind != POLICY_KEYREG && kind != POLICY_PAYMENT) {
+            THROW(0x6B00);
+          }
+
+          if (kind == POLICY_PAYMENT) {
+            len += sizeof(pending_policy.receiver) + sizeof(uint64_t);
+          } else {
+            len += 2 * sizeof(uint64_t);
+          }
+          if (rx <= OFFSET_LC || G_io_apdu_buffer[OFFSET_LC] != len) {
+            THROW(0x6a85);
+          }
+
+          os_memset(&pending_policy, 0, sizeof(pending_policy));
+          pending_policy.kind = kind;
+          pending_policy.accountId = U4BE(cdata, 0);
+          pending_policy.max_fee = u64be(&cdata[4]);
+          if (kind == POLICY_PAYMENT) {
+            os_memmove(pending_policy.receiver, &cdata[12], sizeof(pending_policy.receiver));
+            pending_policy.max_amount = u64be(&cdata[44]);
+          } else {
+            pending_policy.vote_first = u64be(&cdata[12]);
+            pending_policy.vote_last = u64be(&cdata[20]);
+            if (pending_policy.vote_first > pending_policy.vote_last) {
+              THROW(0x6A80);
+            }
+          }
+
+          ui_policy(&pending_policy);
+          flags |= IO_ASYNCH_REPLY;
+        } break;
+
         case 0xFF: // return to dashboard
           CLOSE_TRY;
           goto return_to_dashboard;
@@ -319,6 +1558,17 @@ algorand_main(void)
         }
       }
       CATCH(EXCEPTION_IO_RESET){
+        bool resumable = upload_resumable;
+        bool signed_txn_resumed = signed_txn_requested;
+        stream_reset();
+        // The bytes, decoder and transaction of a resumable upload stay
+        // as they are until it resumes.
+        if (resumable) {
+          upload_resumable = true;
+          signed_txn_requested = signed_txn_resumed;
+        }
+        signing_key_end();
+        os_memset(&policy, 0, sizeof(policy));
         THROW(EXCEPTION_IO_RESET);
       }
       CATCH_OTHER(e) {
@@ -343,6 +1593,7 @@ algorand_main(void)
   }
 
 return_to_dashboard:
+  signing_key_end();
   return;
 }
 
@@ -380,6 +1631,7 @@ unsigned char io_event(unsigned char channel) {
     break;
 
   case SEPROXYHAL_TAG_TICKER_EVENT:
+    signing_key_tick();
     UX_TICKER_EVENT(G_io_seproxyhal_spi_buffer,
     {
     });
@@ -422,6 +1674,9 @@ io_exchange_al(unsigned char channel, unsigned short tx_len)
 }
 
 void app_exit(void) {
+  signing_key_end();
+  pubkey_cache_save();
+
   BEGIN_TRY_L(exit) {
     TRY_L(exit) {
       os_sched_exit(-1);
@@ -2,6 +2,8 @@
 #define FIXINT_127  0x7f
 #define FIXMAP_0    0x80
 #define FIXMAP_15   0x8f
+#define FIXARR_0    0x90
+#define FIXARR_15   0x9f
 #define FIXSTR_0    0xa0
 #define FIXSTR_31   0xbf
 #define BOOL_FALSE  0xc2
@@ -13,3 +15,5 @@
 #define UINT32      0xce
 #define UINT64      0xcf
 #define STR8        0xd9
+#define ARR16       0xdc
+#define MAP16       0xde
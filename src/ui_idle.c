@@ -17,10 +17,36 @@ UX_FLOW_DEF_NOCB(
       "Version",
       APPVERSION,
     });
+/* Settings, kept in NVRAM. */
+typedef struct {
+  uint8_t expert_mode;
+} settings_t;
+
+const settings_t N_settings_real;
+#define N_settings (*(volatile settings_t *) PIC(&N_settings_real))
+
+static char expert_mode_text[4];
+
+bool
+ui_expert_mode(void)
+{
+  return N_settings.expert_mode != 0;
+}
+
+static void ui_idle_toggle_expert_mode();
+
+UX_FLOW_DEF_VALID(
+    ux_idle_flow_expert_step,
+    bn,
+    ui_idle_toggle_expert_mode(),
+    {
+      "Expert mode",
+      expert_mode_text,
+    });
 UX_FLOW_DEF_VALID(
     ux_idle_flow_exit_step,
     pb,
-    os_sched_exit(-1),
+    app_exit(),
     {
       &C_icon_dashboard_x,
       "Quit",
@@ -28,17 +54,34 @@ UX_FLOW_DEF_VALID(
 UX_FLOW(ux_idle_flow,
   &ux_idle_flow_welcome_step,
   &ux_idle_flow_version_step,
+  &ux_idle_flow_expert_step,
   &ux_idle_flow_exit_step,
   FLOW_LOOP
 );
 
 
-void
-ui_idle()
+static void
+ui_idle_show(const ux_flow_step_t *step)
 {
+  snprintf(expert_mode_text, sizeof(expert_mode_text), "%s", ui_expert_mode() ? "On" : "Off");
+
   // reserve a display stack slot if none yet
   if(G_ux.stack_count == 0) {
     ux_stack_push();
   }
-  ux_flow_init(0, ux_idle_flow, NULL);
+  ux_flow_init(0, ux_idle_flow, step);
+}
+
+static void
+ui_idle_toggle_expert_mode()
+{
+  uint8_t expert_mode = !ui_expert_mode();
+  nvm_write((void *) &N_settings.expert_mode, &expert_mode, sizeof(expert_mode));
+  ui_idle_show(&ux_idle_flow_expert_step);
+}
+
+void
+ui_idle()
+{
+  ui_idle_show(NULL);
 }
@@ -15,15 +15,14 @@ char lineBuffer[MAX_CHARS_PER_LINE+2+1];
 void
 ui_text_putn(const char *msg, size_t maxlen)
 {
-  for (unsigned int i = 0; i < sizeof(text) && i < maxlen; i++) {
-    text[i] = msg[i];
+  unsigned int i;
 
-    if (msg[i] == '\0') {
-      break;
-    }
+  // msg need not be NUL-terminated within maxlen
+  for (i = 0; i < sizeof(text)-1 && i < maxlen && msg[i] != '\0'; i++) {
+    text[i] = msg[i];
   }
 
-  text[sizeof(text)-1] = '\0';
+  text[i] = '\0';
   lineBufferPos = 0;
 
   PRINTF("ui_text_putn: text %s\n", &text[0]);
@@ -4,10 +4,14 @@
 
 #include "algo_ui.h"
 #include "algo_tx.h"
+#include "algo_group.h"
+#include "algo_policy.h"
+#include "algo_program.h"
 #include "algo_addr.h"
 #include "algo_keys.h"
 #include "algo_asa.h"
 #include "base64.h"
+#include "base32.h"
 #include "glyphs.h"
 
 bool is_opt_in_tx(){
@@ -24,10 +28,12 @@ bool is_opt_in_tx(){
 
 char caption[20];
 
+#define U64STR_SIZE 27
+
 static char *
 u64str(uint64_t v)
 {
-  static char buf[27];
+  static char buf[U64STR_SIZE];
 
   char *p = &buf[sizeof(buf)];
   *(--p) = '\0';
@@ -112,11 +118,14 @@ bool adjustDecimals(char *src, uint32_t srcLength, char *target,
 static char*
 amount_to_str(uint64_t amount, uint8_t decimals){
   char* result = u64str(amount);
+  size_t len = strlen(result);
   char tmp[24];
-  memcpy(tmp, result, sizeof(tmp));
-  memset(result, 0, sizeof(tmp));
-  adjustDecimals(tmp, strlen(tmp), result, 27, decimals);
-  result[26] = '\0';
+  memcpy(tmp, result, len + 1);
+  // u64str() fills its buffer from the end: start over from its start.
+  result += len + 1 - U64STR_SIZE;
+  memset(result, 0, U64STR_SIZE);
+  adjustDecimals(tmp, len, result, U64STR_SIZE, decimals);
+  result[U64STR_SIZE - 1] = '\0';
   return result;
 }
 
@@ -158,6 +167,10 @@ static int step_txn_type() {
     ui_text_put("Asset config");
     break;
 
+  case APPLICATION:
+    ui_text_put("Application");
+    break;
+
   default:
     ui_text_put("Unknown");
   }
@@ -177,6 +190,29 @@ static int step_sender() {
   return 1;
 }
 
+// Appends to text, truncating it as snprintf() does.
+#define text_append(...) \
+  snprintf(text + strlen(text), sizeof(text) - strlen(text), __VA_ARGS__)
+
+/* The accounts signing for several subkeys of a multisig account at
+ * once, if any.
+ */
+static const uint32_t *review_signers;
+static uint8_t review_signers_count;
+
+static int step_signers() {
+  if (review_signers_count == 0) {
+    return 0;
+  }
+
+  snprintf(text, sizeof(text), "Accounts ");
+  for (int i = 0; i < review_signers_count; i++) {
+    char *str = u64str(review_signers[i]);
+    text_append("%s%s", str, i + 1 < review_signers_count ? ", " : "");
+  }
+  return 1;
+}
+
 static int step_rekey() {
   if (all_zero_key(current_txn.rekey)) {
     return 0;
@@ -208,16 +244,27 @@ static const uint8_t default_genesisHash[] = {
   0xc0, 0x61, 0xc4, 0xd8, 0xfc, 0x1d, 0xbd, 0xde, 0xd2, 0xd7, 0x60, 0x4b, 0xe4, 0x56, 0x8e, 0x3f, 0x6d, 0x4, 0x19, 0x87, 0xac, 0x37, 0xbd, 0xe4, 0xb6, 0x20, 0xb5, 0xab, 0x39, 0x24, 0x8a, 0xdf,
 };
 
-static int step_genesisID() {
-  if (strncmp(current_txn.genesisID, default_genesisID, sizeof(current_txn.genesisID)) == 0) {
-    return 0;
+static void ui_text_put_view(tx_view_t v) {
+  ui_text_putn((const char*) tx_view(&current_txn, v), v.len);
+}
+
+static int default_or_empty_genesisID() {
+  tx_view_t v = current_txn.genesisID;
+
+  if (v.len == 0) {
+    return 1;
   }
 
-  if (current_txn.genesisID[0] == '\0') {
+  return v.len == strlen(default_genesisID) &&
+         os_memcmp(tx_view(&current_txn, v), default_genesisID, v.len) == 0;
+}
+
+static int step_genesisID() {
+  if (default_or_empty_genesisID()) {
     return 0;
   }
 
-  ui_text_putn(current_txn.genesisID, sizeof(current_txn.genesisID));
+  ui_text_put_view(current_txn.genesisID);
   return 1;
 }
 
@@ -226,8 +273,7 @@ static int step_genesisHash() {
     return 0;
   }
 
-  if (strncmp(current_txn.genesisID, default_genesisID, sizeof(current_txn.genesisID)) == 0 ||
-      current_txn.genesisID[0] == '\0') {
+  if (default_or_empty_genesisID()) {
     if (os_memcmp(current_txn.genesisHash, default_genesisHash, sizeof(current_txn.genesisHash)) == 0) {
       return 0;
     }
@@ -239,13 +285,66 @@ static int step_genesisHash() {
   return 1;
 }
 
+static int step_base64_key(const uint8_t *key) {
+  if (all_zero_key((uint8_t *) key)) {
+    return 0;
+  }
+
+  char buf[45];
+  base64_encode((const char*) key, 32, buf, sizeof(buf));
+  ui_text_put(buf);
+  return 1;
+}
+
+static int step_group() {
+  return step_base64_key(current_txn.group);
+}
+
+static int step_lease() {
+  return step_base64_key(current_txn.lease);
+}
+
+static int note_is_printable() {
+  size_t len = current_txn.note_len;
+
+  if (len > sizeof(current_txn.note)) {
+    len = sizeof(current_txn.note);
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    if (current_txn.note[i] < 0x20 || current_txn.note[i] > 0x7e) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
 static int step_note() {
   if (current_txn.note_len == 0) {
     return 0;
   }
 
-  char buf[16];
-  snprintf(buf, sizeof(buf), "%d bytes", current_txn.note_len);
+  if (!note_is_printable()) {
+    snprintf(text, sizeof(text), "%d bytes", current_txn.note_len);
+  } else if (current_txn.note_len <= sizeof(current_txn.note)) {
+    snprintf(text, sizeof(text), "%.*s", (int) current_txn.note_len, current_txn.note);
+  } else {
+    snprintf(text, sizeof(text), "%.*s... (%d bytes)",
+             (int) sizeof(current_txn.note), current_txn.note, current_txn.note_len);
+  }
+  return 1;
+}
+
+static int step_note_hash() {
+  // Only needed when the note is not shown in full.
+  if (current_txn.note_len == 0 ||
+      (current_txn.note_len <= sizeof(current_txn.note) && note_is_printable())) {
+    return 0;
+  }
+
+  char buf[45];
+  base64_encode((const char*) current_txn.note_hash, sizeof(current_txn.note_hash), buf, sizeof(buf));
   ui_text_put(buf);
   return 1;
 }
@@ -330,7 +429,9 @@ static int step_asset_xfer_amount() {
 
   const algo_asset_info_t *asa = algo_asa_get(current_txn.asset_xfer.id);
   if (asa != NULL) {
-    snprintf(caption, sizeof(caption), "Amount (%s)", asa->unit);
+    // Cut a long unit short rather than its closing parenthesis.
+    snprintf(caption, sizeof(caption), "Amount (%.*s)",
+             (int) (sizeof(caption) - sizeof("Amount ()")), asa->unit);
     ui_text_put(amount_to_str(current_txn.asset_xfer.amount, asa->decimals));
   } else {
     snprintf(caption, sizeof(caption), "Amount (base unit)");
@@ -430,11 +531,11 @@ static int step_asset_config_default_frozen() {
 }
 
 static int step_asset_config_unitname() {
-  if (current_txn.asset_config.params.unitname[0] == '\0') {
+  if (current_txn.asset_config.params.unitname.len == 0) {
     return 0;
   }
 
-  ui_text_putn(current_txn.asset_config.params.unitname, sizeof(current_txn.asset_config.params.unitname));
+  ui_text_put_view(current_txn.asset_config.params.unitname);
   return 1;
 }
 
@@ -448,20 +549,20 @@ static int step_asset_config_decimals() {
 }
 
 static int step_asset_config_assetname() {
-  if (current_txn.asset_config.params.assetname[0] == '\0') {
+  if (current_txn.asset_config.params.assetname.len == 0) {
     return 0;
   }
 
-  ui_text_putn(current_txn.asset_config.params.assetname, sizeof(current_txn.asset_config.params.assetname));
+  ui_text_put_view(current_txn.asset_config.params.assetname);
   return 1;
 }
 
 static int step_asset_config_url() {
-  if (current_txn.asset_config.params.url[0] == '\0') {
+  if (current_txn.asset_config.params.url.len == 0) {
     return 0;
   }
 
-  ui_text_putn(current_txn.asset_config.params.url, sizeof(current_txn.asset_config.params.url));
+  ui_text_put_view(current_txn.asset_config.params.url);
   return 1;
 }
 
@@ -503,58 +604,423 @@ static int step_asset_config_clawback() {
   return step_asset_config_addr_helper(current_txn.asset_config.params.clawback);
 }
 
+static int step_application_id() {
+  if (current_txn.application.id == 0) {
+    ui_text_put("Create");
+  } else {
+    ui_text_put(u64str(current_txn.application.id));
+  }
+  return 1;
+}
+
+static const char * const oncompletion_names[] = {
+  "NoOp", "OptIn", "CloseOut", "ClearState", "UpdateApp", "DeleteApp",
+};
+
+static int step_application_oncompletion() {
+  uint64_t oc = current_txn.application.oncompletion;
+
+  if (oc < sizeof(oncompletion_names)/sizeof(oncompletion_names[0])) {
+    ui_text_put((const char*) PIC(oncompletion_names[oc]));
+  } else {
+    ui_text_put(u64str(oc));
+  }
+  return 1;
+}
+
+// Programs and arrays are shown as their length (or element count)
+// and digest, since the device does not keep them.
+static int step_application_digest(const tx_digest_t *dg, const char *unit) {
+  if (dg->len == 0) {
+    return 0;
+  }
+
+  char buf[45];
+  base64_encode((const char*) dg->hash, sizeof(dg->hash), buf, sizeof(buf));
+  snprintf(text, sizeof(text), "%d %s, hash %s", dg->len, unit, buf);
+  return 1;
+}
+
+static int step_application_args() {
+  return step_application_digest(&current_txn.application.args, "args");
+}
+
+static int step_application_accounts() {
+  return step_application_digest(&current_txn.application.accounts, "accounts");
+}
+
+static int step_application_foreign_apps() {
+  return step_application_digest(&current_txn.application.foreign_apps, "apps");
+}
+
+static int step_application_foreign_assets() {
+  return step_application_digest(&current_txn.application.foreign_assets, "assets");
+}
+
+static int step_application_aprog() {
+  return step_application_digest(&current_txn.application.aprog, "bytes");
+}
+
+static int step_application_cprog() {
+  return step_application_digest(&current_txn.application.cprog, "bytes");
+}
+
+static int step_application_schema(const struct state_schema *schema) {
+  if (schema->num_uint == 0 && schema->num_byteslice == 0) {
+    return 0;
+  }
+
+  // Schemas are bounded by small protocol limits.
+  snprintf(text, sizeof(text), "%u uints, %u byte slices",
+           (unsigned int) schema->num_uint, (unsigned int) schema->num_byteslice);
+  return 1;
+}
+
+static int step_application_global_schema() {
+  return step_application_schema(&current_txn.application.global_schema);
+}
+
+static int step_application_local_schema() {
+  return step_application_schema(&current_txn.application.local_schema);
+}
+
+static int step_application_extra_pages() {
+  if (current_txn.application.extra_pages == 0) {
+    return 0;
+  }
+
+  ui_text_put(u64str(current_txn.application.extra_pages));
+  return 1;
+}
+
 typedef int (*format_function_t)();
 typedef struct{
   char* caption;
   format_function_t value_setter;
-  uint8_t type;
+  uint8_t field;            // schema field shown, which gives its tx type
 } screen_t;
 
 #define SCREEN_DYN_CAPTION    NULL
 
 screen_t const screen_table[] = {
-  {"Txn type", &step_txn_type, ALL_TYPES},
-  {"Sender", &step_sender, ALL_TYPES},
-  {"Rekey to", &step_rekey, ALL_TYPES},
-  {"Fee (Alg)", &step_fee, ALL_TYPES},
-  // {"First valid", step_firstvalid, ALL_TYPES},
-  // {"Last valid", step_lastvalid, ALL_TYPES},
-  {"Genesis ID", &step_genesisID, ALL_TYPES},
-  {"Genesis hash", &step_genesisHash, ALL_TYPES},
-  {"Note", &step_note, ALL_TYPES},
-  {"Receiver", &step_receiver, PAYMENT},
-  {"Amount (Alg)", step_amount, PAYMENT},
-  {"Close to", &step_close, PAYMENT},
-  {"Vote PK", &step_votepk, KEYREG},
-  {"VRF PK", &step_vrfpk, KEYREG},
-  {"Vote first", &step_votefirst, KEYREG},
-  {"Vote last", &step_votelast, KEYREG},
-  {"Key dilution", &step_keydilution, KEYREG},
-  {"Participating", &step_participating, KEYREG},
-  {"Asset ID", &step_asset_xfer_id, ASSET_XFER},
-  {SCREEN_DYN_CAPTION, &step_asset_xfer_amount, ASSET_XFER},
-  {"Asset src", &step_asset_xfer_sender, ASSET_XFER},
-  {"Asset dst", &step_asset_xfer_receiver, ASSET_XFER},
-  {"Asset close", &step_asset_xfer_close, ASSET_XFER},
-  {"Asset ID", &step_asset_freeze_id, ASSET_FREEZE},
-  {"Asset account", &step_asset_freeze_account, ASSET_FREEZE},
-  {"Freeze flag", &step_asset_freeze_flag, ASSET_FREEZE},
-  {"Asset ID", &step_asset_config_id, ASSET_CONFIG},
-  {"Total units", &step_asset_config_total, ASSET_CONFIG},
-  {"Default frozen", &step_asset_config_default_frozen, ASSET_CONFIG},
-  {"Unit name", &step_asset_config_unitname, ASSET_CONFIG},
-  {"Decimals", &step_asset_config_decimals, ASSET_CONFIG},
-  {"Asset name", &step_asset_config_assetname, ASSET_CONFIG},
-  {"URL", &step_asset_config_url, ASSET_CONFIG},
-  {"Metadata hash", &step_asset_config_metadata_hash, ASSET_CONFIG},
-  {"Manager", &step_asset_config_manager, ASSET_CONFIG},
-  {"Reserve", &step_asset_config_reserve, ASSET_CONFIG},
-  {"Freezer", &step_asset_config_freeze, ASSET_CONFIG},
-  {"Clawback", &step_asset_config_clawback, ASSET_CONFIG}
+  {"Txn type", &step_txn_type, FIELD_TYPE},
+  {"Sender", &step_sender, FIELD_SND},
+  {"Signers", &step_signers, FIELD_SND},
+  {"Rekey to", &step_rekey, FIELD_REKEY},
+  {"Fee (Alg)", &step_fee, FIELD_FEE},
+  // {"First valid", step_firstvalid, FIELD_FV},
+  // {"Last valid", step_lastvalid, FIELD_LV},
+  {"Genesis ID", &step_genesisID, FIELD_GEN},
+  {"Genesis hash", &step_genesisHash, FIELD_GH},
+  {"Group ID", &step_group, FIELD_GRP},
+  {"Lease", &step_lease, FIELD_LX},
+  {"Note", &step_note, FIELD_NOTE},
+  {"Note hash", &step_note_hash, FIELD_NOTE},
+  {"Receiver", &step_receiver, FIELD_RCV},
+  {"Amount (Alg)", step_amount, FIELD_AMT},
+  {"Close to", &step_close, FIELD_CLOSE},
+  {"Vote PK", &step_votepk, FIELD_VOTEKEY},
+  {"VRF PK", &step_vrfpk, FIELD_SELKEY},
+  {"Vote first", &step_votefirst, FIELD_VOTEFST},
+  {"Vote last", &step_votelast, FIELD_VOTELST},
+  {"Key dilution", &step_keydilution, FIELD_VOTEKD},
+  {"Participating", &step_participating, FIELD_NONPART},
+  {"Asset ID", &step_asset_xfer_id, FIELD_XAID},
+  {SCREEN_DYN_CAPTION, &step_asset_xfer_amount, FIELD_AAMT},
+  {"Asset src", &step_asset_xfer_sender, FIELD_ASND},
+  {"Asset dst", &step_asset_xfer_receiver, FIELD_ARCV},
+  {"Asset close", &step_asset_xfer_close, FIELD_ACLOSE},
+  {"Asset ID", &step_asset_freeze_id, FIELD_FAID},
+  {"Asset account", &step_asset_freeze_account, FIELD_FADD},
+  {"Freeze flag", &step_asset_freeze_flag, FIELD_AFRZ},
+  {"Asset ID", &step_asset_config_id, FIELD_CAID},
+  {"Total units", &step_asset_config_total, FIELD_APAR_T},
+  {"Default frozen", &step_asset_config_default_frozen, FIELD_APAR_DF},
+  {"Unit name", &step_asset_config_unitname, FIELD_APAR_UN},
+  {"Decimals", &step_asset_config_decimals, FIELD_APAR_DC},
+  {"Asset name", &step_asset_config_assetname, FIELD_APAR_AN},
+  {"URL", &step_asset_config_url, FIELD_APAR_AU},
+  {"Metadata hash", &step_asset_config_metadata_hash, FIELD_APAR_AM},
+  {"Manager", &step_asset_config_manager, FIELD_APAR_M},
+  {"Reserve", &step_asset_config_reserve, FIELD_APAR_R},
+  {"Freezer", &step_asset_config_freeze, FIELD_APAR_F},
+  {"Clawback", &step_asset_config_clawback, FIELD_APAR_C},
+  {"App ID", &step_application_id, FIELD_APID},
+  {"On completion", &step_application_oncompletion, FIELD_APAN},
+  {"App args", &step_application_args, FIELD_APAA},
+  {"Accounts", &step_application_accounts, FIELD_APAT},
+  {"Foreign apps", &step_application_foreign_apps, FIELD_APFA},
+  {"Foreign assets", &step_application_foreign_assets, FIELD_APAS},
+  {"Approval prog", &step_application_aprog, FIELD_APAP},
+  {"Clear prog", &step_application_cprog, FIELD_APSU},
+  {"Global schema", &step_application_global_schema, FIELD_APGS},
+  {"Local schema", &step_application_local_schema, FIELD_APLS},
+  {"Extra pages", &step_application_extra_pages, FIELD_APEP}
 };
 
 #define SCREEN_NUM (int8_t)(sizeof(screen_table)/sizeof(screen_t))
 
+/* In expert mode, a transaction is reviewed from its type, sender and
+ * ID only, which the user checks out of band; the full review is one
+ * step away.
+ */
+static uint8_t review_txid[32];
+
+static int step_expert_sender() {
+  char checksummed[65];
+  checksummed_addr(current_txn.sender, checksummed);
+  ui_text_put(checksummed);
+  return 1;
+}
+
+static int step_txid() {
+  char buf[BASE32_LEN(sizeof(review_txid)) + 1];
+
+  os_memset(buf, 0, sizeof(buf));
+  base32_encode(review_txid, sizeof(review_txid), (unsigned char*) buf);
+  // As goal prints it, without padding
+  char *pad = strchr(buf, '=');
+  if (pad != NULL) {
+    *pad = '\0';
+  }
+  ui_text_put(buf);
+  return 1;
+}
+
+screen_t const expert_screen_table[] = {
+  {"Txn type", &step_txn_type, FIELD_TYPE},
+  {"Sender", &step_expert_sender, FIELD_SND},
+  {"Signers", &step_signers, FIELD_SND},
+  {"Txn ID", &step_txid, FIELD_TYPE},
+};
+
+#define EXPERT_SCREEN_NUM (int8_t)(sizeof(expert_screen_table)/sizeof(screen_t))
+
+/* An atomic group is reviewed as a whole: totals over the members to
+ * sign, then one screen summing up each member.
+ */
+static const group_t *current_group;
+
+static int step_group_size() {
+  int sign = 0;
+
+  for (int i = 0; i < current_group->count; i++) {
+    if (current_group->members[i].flags & GROUP_SIGN) {
+      sign++;
+    }
+  }
+
+  snprintf(text, sizeof(text), "%d txns, %d to sign", current_group->count, sign);
+  return 1;
+}
+
+static int step_group_id() {
+  return step_base64_key(current_group->group_id);
+}
+
+static int step_group_fees() {
+  ui_text_put(amount_to_str(current_group->fees, ALGORAND_DECIMALS));
+  return 1;
+}
+
+static int step_group_amount() {
+  if (current_group->amount == 0) {
+    return 0;
+  }
+
+  ui_text_put(amount_to_str(current_group->amount, ALGORAND_DECIMALS));
+  return 1;
+}
+
+static int step_group_member(int i) {
+  const group_member_t *m = &current_group->members[i];
+  char checksummed[65];
+
+  snprintf(caption, sizeof(caption), "Txn %d/%d", i + 1, current_group->count);
+
+  if (m->flags & GROUP_SIGN) {
+    snprintf(text, sizeof(text), "Account %u: ", (unsigned int) m->accountId);
+  } else {
+    snprintf(text, sizeof(text), "Not signed: ");
+  }
+
+  // u64str() and amount_to_str() share a buffer: one per text_append().
+  switch (m->type) {
+  case PAYMENT:
+    checksummed_addr(m->receiver, checksummed);
+    text_append("pay %s Alg", amount_to_str(m->amount, ALGORAND_DECIMALS));
+    text_append(" to %s", checksummed);
+    break;
+
+  case ASSET_XFER: {
+    const algo_asset_info_t *asa = algo_asa_get(m->id);
+
+    checksummed_addr(m->receiver, checksummed);
+    if (asa != NULL) {
+      text_append("send %s %s", amount_to_str(m->amount, asa->decimals), asa->unit);
+    } else {
+      text_append("send %s", u64str(m->amount));
+      text_append(" of #%s", u64str(m->id));
+    }
+    text_append(" to %s", checksummed);
+    break;
+  }
+
+  case KEYREG:
+    text_append("key reg");
+    break;
+
+  case ASSET_FREEZE:
+    text_append("asset freeze #%s", u64str(m->id));
+    break;
+
+  case ASSET_CONFIG:
+    if (m->id == 0) {
+      text_append("asset create");
+    } else {
+      text_append("asset config #%s", u64str(m->id));
+    }
+    break;
+
+  case APPLICATION:
+    if (m->id == 0) {
+      text_append("app create");
+    } else {
+      text_append("app call #%s", u64str(m->id));
+    }
+    break;
+
+  default:
+    text_append("unknown");
+  }
+
+  if (m->flags & GROUP_CLOSE) {
+    text_append(", close");
+  }
+  if (m->flags & GROUP_REKEY) {
+    text_append(", rekey");
+  }
+  return 1;
+}
+
+screen_t const group_screen_table[] = {
+  {"Group", &step_group_size, FIELD_GRP},
+  {"Group ID", &step_group_id, FIELD_GRP},
+  {"Fees (Alg)", &step_group_fees, FIELD_FEE},
+  {"Sent (Alg)", &step_group_amount, FIELD_AMT},
+};
+
+#define GROUP_SCREEN_NUM (int8_t)(sizeof(group_screen_table)/sizeof(screen_t))
+
+/* A signing policy is reviewed once, before the transactions it lets
+ * through without review.
+ */
+static const policy_t *current_policy;
+
+static int step_policy_kind() {
+  if (current_policy->kind == POLICY_KEYREG) {
+    ui_text_put("Key reg");
+  } else {
+    ui_text_put("Payments");
+  }
+  return 1;
+}
+
+static int step_policy_account() {
+  ui_text_put(u64str(current_policy->accountId));
+  return 1;
+}
+
+static int step_policy_max_fee() {
+  ui_text_put(amount_to_str(current_policy->max_fee, ALGORAND_DECIMALS));
+  return 1;
+}
+
+static int step_policy_receiver() {
+  if (current_policy->kind != POLICY_PAYMENT) {
+    return 0;
+  }
+
+  char checksummed[65];
+  checksummed_addr(current_policy->receiver, checksummed);
+  ui_text_put(checksummed);
+  return 1;
+}
+
+static int step_policy_max_amount() {
+  if (current_policy->kind != POLICY_PAYMENT) {
+    return 0;
+  }
+
+  ui_text_put(amount_to_str(current_policy->max_amount, ALGORAND_DECIMALS));
+  return 1;
+}
+
+static int step_policy_vote_first() {
+  if (current_policy->kind != POLICY_KEYREG) {
+    return 0;
+  }
+
+  ui_text_put(u64str(current_policy->vote_first));
+  return 1;
+}
+
+static int step_policy_vote_last() {
+  if (current_policy->kind != POLICY_KEYREG) {
+    return 0;
+  }
+
+  ui_text_put(u64str(current_policy->vote_last));
+  return 1;
+}
+
+screen_t const policy_screen_table[] = {
+  {"Sign without review", &step_policy_kind, FIELD_TYPE},
+  {"Account", &step_policy_account, FIELD_SND},
+  {"Max fee (Alg)", &step_policy_max_fee, FIELD_FEE},
+  {"Receiver", &step_policy_receiver, FIELD_RCV},
+  {"Max amount (Alg)", &step_policy_max_amount, FIELD_AMT},
+  {"Vote from", &step_policy_vote_first, FIELD_VOTEFST},
+  {"Vote until", &step_policy_vote_last, FIELD_VOTELST},
+};
+
+#define POLICY_SCREEN_NUM (int8_t)(sizeof(policy_screen_table)/sizeof(screen_t))
+
+/* A delegated LogicSig program is reviewed from its size and escrow
+ * address, which the user checks against the program they compiled.
+ */
+static struct {
+  uint32_t len;
+  uint8_t hash[32];
+  uint32_t accountId;
+} current_program;
+
+static int step_program_len() {
+  char *str = u64str(current_program.len);
+  snprintf(text, sizeof(text), "%s bytes", str);
+  return 1;
+}
+
+static int step_program_addr() {
+  char checksummed[65];
+  checksummed_addr(current_program.hash, checksummed);
+  ui_text_put(checksummed);
+  return 1;
+}
+
+static int step_program_account() {
+  ui_text_put(u64str(current_program.accountId));
+  return 1;
+}
+
+screen_t const program_screen_table[] = {
+  {"Program", &step_program_len, FIELD_TYPE},
+  {"Program addr", &step_program_addr, FIELD_TYPE},
+  {"Account", &step_program_account, FIELD_SND},
+};
+
+#define PROGRAM_SCREEN_NUM (int8_t)(sizeof(program_screen_table)/sizeof(screen_t))
+
 void display_next_state(bool is_upper_border);
 
 UX_STEP_NOCB(
@@ -608,6 +1074,196 @@ UX_FLOW_DEF_VALID(
       "Transaction"
     });
 
+UX_STEP_NOCB(
+    ux_confirm_group_init_flow_step,
+    pnn,
+    {
+      &C_icon_eye,
+      "Review",
+      "Group",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_confirm_group_finalize_step,
+    pnn,
+    group_approve(),
+    {
+      &C_icon_validate_14,
+      "Sign",
+      "Group",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_reject_group_flow_step,
+    pnn,
+    user_approval_denied(),
+    {
+      &C_icon_crossmark,
+      "Cancel",
+      "Group"
+    });
+
+UX_FLOW(ux_group_flow,
+  &ux_confirm_group_init_flow_step,
+
+  &ux_init_upper_border,
+  &ux_variable_display,
+  &ux_init_lower_border,
+
+  &ux_confirm_group_finalize_step,
+  &ux_reject_group_flow_step
+);
+
+UX_STEP_NOCB(
+    ux_confirm_policy_init_flow_step,
+    pnn,
+    {
+      &C_icon_eye,
+      "Review",
+      "Policy",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_confirm_policy_finalize_step,
+    pnn,
+    policy_approve(),
+    {
+      &C_icon_validate_14,
+      "Approve",
+      "Policy",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_reject_policy_flow_step,
+    pnn,
+    user_approval_denied(),
+    {
+      &C_icon_crossmark,
+      "Reject",
+      "Policy"
+    });
+
+UX_FLOW(ux_policy_flow,
+  &ux_confirm_policy_init_flow_step,
+
+  &ux_init_upper_border,
+  &ux_variable_display,
+  &ux_init_lower_border,
+
+  &ux_confirm_policy_finalize_step,
+  &ux_reject_policy_flow_step
+);
+
+UX_STEP_NOCB(
+    ux_confirm_program_init_flow_step,
+    pnn,
+    {
+      &C_icon_eye,
+      "Review",
+      "Program",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_confirm_program_finalize_step,
+    pnn,
+    program_approve(false),
+    {
+      &C_icon_validate_14,
+      "Sign",
+      "Program",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_remember_program_step,
+    pnn,
+    program_approve(true),
+    {
+      &C_icon_validate_14,
+      "Sign and",
+      "remember",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_reject_program_flow_step,
+    pnn,
+    user_approval_denied(),
+    {
+      &C_icon_crossmark,
+      "Cancel",
+      "Program"
+    });
+
+UX_FLOW(ux_program_flow,
+  &ux_confirm_program_init_flow_step,
+
+  &ux_init_upper_border,
+  &ux_variable_display,
+  &ux_init_lower_border,
+
+  &ux_confirm_program_finalize_step,
+  &ux_remember_program_step,
+  &ux_reject_program_flow_step
+);
+
+UX_STEP_NOCB(
+    ux_forget_programs_init_flow_step,
+    pnn,
+    {
+      &C_icon_eye,
+      "Forget all",
+      "programs?",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_forget_programs_finalize_step,
+    pnn,
+    program_forget_approve(),
+    {
+      &C_icon_validate_14,
+      "Forget",
+      "programs",
+    });
+
+UX_FLOW_DEF_VALID(
+    ux_keep_programs_flow_step,
+    pnn,
+    user_approval_denied(),
+    {
+      &C_icon_crossmark,
+      "Keep",
+      "programs"
+    });
+
+UX_FLOW(ux_forget_programs_flow,
+  &ux_forget_programs_init_flow_step,
+  &ux_forget_programs_finalize_step,
+  &ux_keep_programs_flow_step
+);
+
+static void ui_txn_full_review();
+
+UX_FLOW_DEF_VALID(
+    ux_full_review_step,
+    pnn,
+    ui_txn_full_review(),
+    {
+      &C_icon_eye,
+      "Full",
+      "review",
+    });
+
+UX_FLOW(ux_expert_txn_flow,
+  &ux_confirm_tx_init_flow_step,
+
+  &ux_init_upper_border,
+  &ux_variable_display,
+  &ux_init_lower_border,
+
+  &ux_full_review_step,
+  &ux_confirm_tx_finalize_step,
+  &ux_reject_tx_flow_step
+);
+
 UX_FLOW(ux_txn_flow,
   &ux_confirm_tx_init_flow_step,
 
@@ -619,29 +1275,100 @@ UX_FLOW(ux_txn_flow,
   &ux_reject_tx_flow_step
 );
 
+/* The steps of the review shown, as indices in its screen table, with
+ * the steps that show nothing for this transaction left out.  They are
+ * listed once when the review starts, so that moving between steps
+ * formats only the step shown.  The steps of a group review past its
+ * table are its members.
+ */
+static const ux_flow_step_t * const *review_flow;
+static const screen_t *review_table;
+static uint8_t review_table_num;
+static uint8_t review_steps[SCREEN_NUM];    // the full review has the most
+static uint8_t review_steps_num;             // the N of "i/N" captions
+
 volatile int8_t current_data_index;
+volatile uint8_t current_state;
+
+#define INSIDE_BORDERS 0
+#define OUT_OF_BORDERS 1
+
+static bool set_screen(uint8_t step){
+    if(step >= review_table_num){
+      // Member screens set their own caption
+      return step_group_member(step - review_table_num);
+    }
+
+    const screen_t *screen = &review_table[step];
+    if(((format_function_t)PIC(screen->value_setter))() == 0){
+      return false;
+    }
+    if(screen->caption != SCREEN_DYN_CAPTION){
+      snprintf(caption, sizeof(caption), "%s", (char*)PIC(screen->caption));
+    }
+    return true;
+}
+
+/* review_start lists the steps of a review of the num screens of table,
+ * followed by member steps, and shows its flow.  Only the screens of
+ * the full review depend on the transaction type.
+ */
+static void review_start(const ux_flow_step_t * const *flow,
+                         const screen_t *table, uint8_t num, uint8_t members){
+    review_flow = flow;
+    review_table = table;
+    review_table_num = num;
+    review_steps_num = 0;
+
+    for(uint8_t i = 0; i < num + members; i++){
+      if(table == screen_table){
+        uint8_t type = tx_fields[table[i].field].type;
+        if(type != ALL_TYPES && type != current_txn.type){
+          continue;
+        }
+      }
+      if(set_screen(i)){
+        review_steps[review_steps_num++] = i;
+      }
+    }
+
+    current_data_index = -1;
+    current_state = OUT_OF_BORDERS;
+    if (G_ux.stack_count == 0) {
+      ux_stack_push();
+    }
+    ux_flow_init(0, flow, NULL);
+}
+
+/* caption_put_position appends the position of the step shown, "i/N",
+ * to its caption, cutting the caption short when both do not fit.
+ */
+static void caption_put_position(uint8_t i, uint8_t n){
+    char pos[8];
+    int pos_len = snprintf(pos, sizeof(pos), " %u/%u", i, n);
+    size_t len = strnlen(caption, sizeof(caption) - 1 - pos_len);
+
+    while(len > 0 && caption[len - 1] == ' '){
+      len--;
+    }
+    snprintf(&caption[len], sizeof(caption) - len, "%s", pos);
+}
 
 bool set_state_data(bool forward){
-    // Apply last formatter to fill the screen's buffer
-    do{
-      current_data_index = forward ? current_data_index+1 : current_data_index-1;
-      if(screen_table[current_data_index].type == ALL_TYPES ||
-         screen_table[current_data_index].type == current_txn.type){
-           if(((format_function_t)PIC(screen_table[current_data_index].value_setter))() != 0){
-             break;
-           }
-         }
-    } while(current_data_index >= 0 &&
-            current_data_index < SCREEN_NUM);
-
-    if(current_data_index < 0 || current_data_index >= SCREEN_NUM){
+    current_data_index = forward ? current_data_index+1 : current_data_index-1;
+    if(current_data_index < 0){
+      current_data_index = -1;
+      return false;
+    }
+    if(current_data_index >= review_steps_num){
+      current_data_index = review_steps_num;
       return false;
     }
 
-    if (screen_table[current_data_index].caption != SCREEN_DYN_CAPTION) {
-      strncpy(caption,
-              (char*)PIC(screen_table[current_data_index].caption),
-              sizeof(caption));
+    set_screen(review_steps[current_data_index]);
+    if(review_steps[current_data_index] < review_table_num){
+      // Member screens show their own position in the group
+      caption_put_position(current_data_index + 1, review_steps_num);
     }
 
     PRINTF("caption: %s\n", caption);
@@ -649,11 +1376,11 @@ bool set_state_data(bool forward){
     return true;
 }
 
-volatile uint8_t current_state;
-
-#define INSIDE_BORDERS 0
-#define OUT_OF_BORDERS 1
-
+/* The flow holds a single step, ux_variable_display, for every step of
+ * the review: the borders around it move to the next or previous step
+ * of the review, and show ux_variable_display again with it, until the
+ * review runs out of steps.
+ */
 void display_next_state(bool is_upper_border){
 
     if(is_upper_border){
@@ -681,11 +1408,7 @@ void display_next_state(bool is_upper_border){
         }
         else{
             if(set_state_data(true)){ // -> from middle, more screens available
-                /*dirty hack to have coherent behavior on bnnn_paging when there are multiple screens*/
-                G_ux.flow_stack[G_ux.stack_count-1].prev_index = G_ux.flow_stack[G_ux.stack_count-1].index-2;
-                G_ux.flow_stack[G_ux.stack_count-1].index--;
-                ux_flow_relayout();
-                /*end of dirty hack*/
+                ux_flow_init(0, review_flow, &ux_variable_display);
             }
             else{ // -> from middle, no more screens available
                 current_state = OUT_OF_BORDERS;
@@ -697,14 +1420,19 @@ void display_next_state(bool is_upper_border){
 }
 
 
-void ui_txn(void) {
+void ui_txn(const uint8_t *txid) {
+  ui_txn_signers(txid, NULL, 0);
+}
+
+void ui_txn_signers(const uint8_t *txid, const uint32_t *accounts, uint8_t count) {
   PRINTF("Transaction:\n");
   PRINTF("  Type: %d\n", current_txn.type);
   PRINTF("  Sender: %.*h\n", 32, current_txn.sender);
   PRINTF("  Fee: %s\n", amount_to_str(current_txn.fee, ALGORAND_DECIMALS));
   PRINTF("  First valid: %s\n", u64str(current_txn.firstValid));
   PRINTF("  Last valid: %s\n", u64str(current_txn.lastValid));
-  PRINTF("  Genesis ID: %.*s\n", 32, current_txn.genesisID);
+  PRINTF("  Genesis ID: %.*s\n", (int) current_txn.genesisID.len,
+         tx_view(&current_txn, current_txn.genesisID));
   PRINTF("  Genesis hash: %.*h\n", 32, current_txn.genesisHash);
   if (current_txn.type == PAYMENT) {
     PRINTF("  Receiver: %.*h\n", 32, current_txn.payment.receiver);
@@ -722,10 +1450,51 @@ void ui_txn(void) {
     PRINTF("  VRF PK: %.*h\n", 32, current_txn.keyreg.vrfpk);
   }
 
-  current_data_index = -1;
-  current_state = OUT_OF_BORDERS;
+  current_group = NULL;
+  current_policy = NULL;
+  review_signers = accounts;
+  review_signers_count = count;
+  if (txid != NULL && ui_expert_mode()) {
+    os_memmove(review_txid, txid, sizeof(review_txid));
+    review_start(ux_expert_txn_flow, expert_screen_table, EXPERT_SCREEN_NUM, 0);
+  } else {
+    review_start(ux_txn_flow, screen_table, SCREEN_NUM, 0);
+  }
+}
+
+static void ui_txn_full_review() {
+  review_start(ux_txn_flow, screen_table, SCREEN_NUM, 0);
+}
+
+void ui_group(const group_t *g) {
+  PRINTF("Group: %.*h, %d txns\n", 32, g->group_id, g->count);
+
+  current_group = g;
+  current_policy = NULL;
+  review_start(ux_group_flow, group_screen_table, GROUP_SCREEN_NUM, g->count);
+}
+
+void ui_policy(const policy_t *p) {
+  current_group = NULL;
+  current_policy = p;
+  review_start(ux_policy_flow, policy_screen_table, POLICY_SCREEN_NUM, 0);
+}
+
+void ui_program(uint32_t len, const uint8_t *hash, uint32_t accountId) {
+  PRINTF("Program: %d bytes, %.*h\n", len, 32, hash);
+
+  current_program.len = len;
+  os_memmove(current_program.hash, hash, sizeof(current_program.hash));
+  current_program.accountId = accountId;
+
+  current_group = NULL;
+  current_policy = NULL;
+  review_start(ux_program_flow, program_screen_table, PROGRAM_SCREEN_NUM, 0);
+}
+
+void ui_program_forget(void) {
   if (G_ux.stack_count == 0) {
     ux_stack_push();
   }
-  ux_flow_init(0, ux_txn_flow, NULL);
+  ux_flow_init(0, ux_forget_programs_flow, NULL);
 }
@@ -0,0 +1,556 @@
+/* Host microbenchmarks for the codec core: msgpack decode/encode,
+ * delta application, address checksumming, base32 and the review
+ * screen formatters, over a corpus holding every transaction type.
+ *
+ * Every corpus entry is round-tripped (encode, decode, encode) and
+ * through its compact encoding before timing, and a delta checked
+ * against the same change made by hand, so the benchmark also fails
+ * loudly on codec regressions.
+ */
+#include <time.h>
+
+#include "os.h"
+#include "algo_tx.h"
+#include "algo_addr.h"
+#include "algo_ui.h"
+#include "base32.h"
+
+extern volatile int8_t current_data_index;
+extern bool host_expert_mode;
+bool set_state_data(bool forward);
+
+#define MIN_BENCH_NS 200000000ULL
+
+/* APDU payload size used by the host tools. */
+#define STREAM_CHUNK 250
+
+/* The least room main.c gives the strings of a delta or compact
+ * transaction: those of the template and one APDU of new ones.
+ */
+#define STRINGS_ARENA_SIZE (TX_STRINGS_MAX + 255)
+
+typedef struct {
+  const char *name;
+  txn_t txn;
+  uint8_t enc[1024];
+  unsigned int enc_len;
+} corpus_entry_t;
+
+static corpus_entry_t corpus[8];
+static unsigned int corpus_len;
+
+static volatile unsigned int sink;
+
+/* Backing store for the corpus' string views. */
+static uint8_t strings[512];
+static uint16_t strings_len;
+
+static void
+fill(uint8_t *buf, size_t len, uint8_t seed)
+{
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = seed + i * 7;
+  }
+}
+
+static void
+set_view(txn_t *t, tx_view_t *v, const char *s)
+{
+  v->off = strings_len;
+  v->len = strlen(s);
+  memcpy(strings + strings_len, s, v->len);
+  strings_len += v->len;
+  t->view_base = strings;
+}
+
+static txn_t *
+corpus_add(const char *name, enum TXTYPE type)
+{
+  corpus_entry_t *c = &corpus[corpus_len++];
+  txn_t *t = &c->txn;
+
+  c->name = name;
+  memset(t, 0, sizeof(*t));
+  t->type = type;
+  fill(t->sender, sizeof(t->sender), 1);
+  t->fee = 1000;
+  t->firstValid = 5667360;
+  t->lastValid = 5668360;
+  set_view(t, &t->genesisID, "testnet-v1.0");
+  fill(t->genesisHash, sizeof(t->genesisHash), 2);
+  return t;
+}
+
+static void
+build_corpus(void)
+{
+  txn_t *t;
+
+  t = corpus_add("pay", PAYMENT);
+  fill(t->payment.receiver, 32, 3);
+  t->payment.amount = 1000000;
+  memcpy(t->note, "Hello World", 11);
+  t->note_len = 11;
+
+  t = corpus_add("pay-close-rekey", PAYMENT);
+  fill(t->payment.receiver, 32, 3);
+  fill(t->payment.close, 32, 4);
+  fill(t->rekey, 32, 5);
+  t->payment.amount = 123456789012ULL;
+
+  t = corpus_add("keyreg", KEYREG);
+  fill(t->keyreg.votepk, 32, 6);
+  fill(t->keyreg.vrfpk, 32, 7);
+  t->keyreg.voteFirst = 6000000;
+  t->keyreg.voteLast = 9000000;
+  t->keyreg.keyDilution = 1733;
+
+  t = corpus_add("axfer", ASSET_XFER);
+  t->asset_xfer.id = 312769;
+  t->asset_xfer.amount = 250000;
+  fill(t->asset_xfer.receiver, 32, 8);
+  fill(t->asset_xfer.close, 32, 9);
+
+  t = corpus_add("afrz", ASSET_FREEZE);
+  t->asset_freeze.id = 438840;
+  fill(t->asset_freeze.account, 32, 10);
+  t->asset_freeze.flag = 1;
+
+  t = corpus_add("acfg-create", ASSET_CONFIG);
+  t->asset_config.params.total = 10000000000ULL;
+  t->asset_config.params.decimals = 6;
+  t->asset_config.params.default_frozen = 1;
+  set_view(t, &t->asset_config.params.unitname, "BENCH");
+  set_view(t, &t->asset_config.params.assetname, "Benchmark asset");
+  set_view(t, &t->asset_config.params.url, "https://example.com/asset.json");
+  fill(t->asset_config.params.metadata_hash, 32, 11);
+  fill(t->asset_config.params.manager, 32, 12);
+  fill(t->asset_config.params.reserve, 32, 13);
+  fill(t->asset_config.params.freeze, 32, 14);
+  fill(t->asset_config.params.clawback, 32, 15);
+
+  t = corpus_add("acfg-destroy", ASSET_CONFIG);
+  t->asset_config.id = 438831;
+
+  t = corpus_add("appl-optin", APPLICATION);
+  t->application.id = 1284326447;
+  t->application.oncompletion = 1;
+  t->application.global_schema.num_uint = 4;
+  t->application.local_schema.num_byteslice = 2;
+}
+
+static int
+check_corpus(void)
+{
+  int failed = 0;
+
+  for (unsigned int i = 0; i < corpus_len; i++) {
+    corpus_entry_t *c = &corpus[i];
+    uint8_t reenc[sizeof(c->enc)];
+    txn_t t;
+
+    c->enc_len = tx_encode(&c->txn, c->enc, sizeof(c->enc));
+
+    memset(&t, 0, sizeof(t));
+    int err = tx_decode(c->enc, c->enc_len, &t);
+    if (err != TXDEC_OK) {
+      fprintf(stderr, "%s: decode failed: error %d\n", c->name, err);
+      failed = 1;
+      continue;
+    }
+
+    unsigned int reenc_len = tx_encode(&t, reenc, sizeof(reenc));
+    if (reenc_len != c->enc_len || memcmp(reenc, c->enc, reenc_len) != 0) {
+      fprintf(stderr, "%s: round trip mismatch\n", c->name);
+      failed = 1;
+    }
+  }
+
+  // A note longer than its preview is only kept as a digest, and
+  // cannot be encoded again.
+  txn_t t = corpus[0].txn;
+  uint8_t enc[sizeof(corpus[0].enc)];
+  t.note_len = sizeof(t.note) + 1;
+  if (tx_encode(&t, enc, sizeof(enc)) != 0) {
+    fprintf(stderr, "%s: digested note encoded\n", corpus[0].name);
+    failed = 1;
+  }
+
+  return failed;
+}
+
+/* A delta moving a payment to the next round range, with another
+ * amount and receiver, as a bulk payment flow would send.
+ */
+static unsigned int
+build_delta(uint8_t *delta, const uint8_t *receiver)
+{
+  uint8_t *p = delta;
+
+  memcpy(p, "\x03" "amt" "\x03" "\x0f\x42\x40", 8);
+  p += 8;
+  memcpy(p, "\x02" "fv" "\x04" "\x00\x56\x7a\x21", 8);
+  p += 8;
+  memcpy(p, "\x02" "lv" "\x04" "\x00\x56\x7e\x09", 8);
+  p += 8;
+  memcpy(p, "\x03" "rcv" "\x20", 5);
+  memcpy(p + 5, receiver, 32);
+  p += 5 + 32;
+  return p - delta;
+}
+
+/* The strings of a delta come on top of the template's: an asset
+ * configuration with every string at its max, whose genesis ID a delta
+ * sets several times over, still fits.
+ */
+static int
+check_delta_strings(void)
+{
+  static const char gen[] = "0123456789abcdef0123456789abcdef";
+  static const char un[] = "01234567";
+  uint8_t enc[1024], delta[4 * (1 + 3 + 1 + 32)], *p = delta;
+  uint8_t arena[STRINGS_ARENA_SIZE];
+  txn_t t;
+
+  memset(&t, 0, sizeof(t));
+  t.type = ASSET_CONFIG;
+  fill(t.sender, sizeof(t.sender), 1);
+  set_view(&t, &t.genesisID, gen);
+  set_view(&t, &t.asset_config.params.assetname, gen);
+  set_view(&t, &t.asset_config.params.url, gen);
+  set_view(&t, &t.asset_config.params.unitname, un);
+  unsigned int len = tx_encode(&t, enc, sizeof(enc));
+
+  for (int i = 0; i < 4; i++) {
+    memcpy(p, "\x03" "gen" "\x20", 5);
+    memcpy(p + 5, gen, 32);
+    p[5] = 'A' + i;
+    p += 5 + 32;
+  }
+
+  memset(&t, 0, sizeof(t));
+  if (tx_decode(enc, len, &t) != TXDEC_OK ||
+      !tx_apply_delta(&t, delta, p - delta, arena, sizeof(arena)) ||
+      t.genesisID.len != 32 || tx_view(&t, t.genesisID)[0] != 'D') {
+    fprintf(stderr, "acfg: delta of long strings failed\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+static int
+check_delta(const corpus_entry_t *c, const uint8_t *delta, unsigned int delta_len)
+{
+  uint8_t enc[sizeof(c->enc)], expected[sizeof(c->enc)];
+  uint8_t arena[STRINGS_ARENA_SIZE];
+  txn_t t;
+
+  memset(&t, 0, sizeof(t));
+  if (tx_decode((uint8_t *) c->enc, c->enc_len, &t) != TXDEC_OK ||
+      !tx_apply_delta(&t, delta, delta_len, arena, sizeof(arena))) {
+    fprintf(stderr, "%s: delta failed\n", c->name);
+    return 1;
+  }
+  unsigned int len = tx_encode(&t, enc, sizeof(enc));
+
+  t = c->txn;
+  t.payment.amount = 1000000;
+  t.firstValid = 5667361;
+  t.lastValid = 5668361;
+  fill(t.payment.receiver, 32, 16);
+  unsigned int expected_len = tx_encode(&t, expected, sizeof(expected));
+
+  if (len != expected_len || memcmp(enc, expected, len) != 0) {
+    fprintf(stderr, "%s: delta mismatch\n", c->name);
+    return 1;
+  }
+
+  return 0;
+}
+
+static void
+put_varint(uint8_t **p, uint64_t v)
+{
+  while (v >= 0x80) {
+    *(*p)++ = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  *(*p)++ = v;
+}
+
+/* build_compact produces the compact encoding of t, naming its network
+ * by index if it is a known one, as a host would.
+ */
+static unsigned int
+build_compact(const txn_t *t, uint8_t *out)
+{
+  uint8_t *p = out, *bitmap;
+  uint8_t network = TX_NETWORK_NONE;
+
+  for (uint8_t i = 0; i < TX_NETWORK_COUNT; i++) {
+    if (t->genesisID.len == strlen(tx_networks[i].id) &&
+        memcmp(tx_view(t, t->genesisID), tx_networks[i].id, t->genesisID.len) == 0 &&
+        memcmp(t->genesisHash, tx_networks[i].hash, 32) == 0) {
+      network = i;
+    }
+  }
+
+  *p++ = t->type;
+  *p++ = network;
+  bitmap = p;
+  memset(bitmap, 0, TX_COMPACT_BITMAP_LEN);
+  p += TX_COMPACT_BITMAP_LEN;
+
+  for (int id = 0; id < TX_COMPACT_ID_COUNT; id++) {
+    uint8_t i = tx_compact_fields[id];
+    const tx_field_t *f = &tx_fields[i];
+    const uint8_t *val = (const uint8_t *) t + f->offset;
+    uint8_t *psave = p;
+
+    if ((f->type != ALL_TYPES && f->type != t->type) ||
+        (network != TX_NETWORK_NONE && (i == FIELD_GEN || i == FIELD_GH))) {
+      continue;
+    }
+
+    switch (f->kind) {
+    case KIND_UINT64:
+      if (*(const uint64_t *) val != 0) {
+        put_varint(&p, *(const uint64_t *) val);
+      }
+      break;
+    case KIND_BOOL:
+      if (*val == 0) {
+        continue;
+      }
+      break;
+    case KIND_STR: {
+      const tx_view_t *v = (const tx_view_t *) val;
+      if (v->len != 0) {
+        *p++ = v->len;
+        memcpy(p, tx_view(t, *v), v->len);
+        p += v->len;
+      }
+      break;
+    }
+    case KIND_BIN_FIXED:
+      for (int j = 0; j < f->size; j++) {
+        if (val[j] != 0) {
+          memcpy(p, val, f->size);
+          p += f->size;
+          break;
+        }
+      }
+      break;
+    case KIND_BIN_DIGEST:
+      if (t->note_len != 0) {
+        *p++ = t->note_len;
+        memcpy(p, val, t->note_len);
+        p += t->note_len;
+      }
+      break;
+    default:
+      continue;
+    }
+
+    if (p != psave || f->kind == KIND_BOOL) {
+      bitmap[id / 8] |= 1 << (id % 8);
+    }
+  }
+
+  return p - out;
+}
+
+static int
+check_compact(const corpus_entry_t *c)
+{
+  uint8_t compact[sizeof(c->enc)], enc[sizeof(c->enc)];
+  uint8_t arena[STRINGS_ARENA_SIZE];
+  txn_t t;
+
+  unsigned int compact_len = build_compact(&c->txn, compact);
+  memset(&t, 0, sizeof(t));
+  if (!tx_decode_compact(&t, compact, compact_len, arena, sizeof(arena))) {
+    fprintf(stderr, "%s: compact decode failed\n", c->name);
+    return 1;
+  }
+
+  unsigned int len = tx_encode(&t, enc, sizeof(enc));
+  if (len != c->enc_len || memcmp(enc, c->enc, len) != 0) {
+    fprintf(stderr, "%s: compact mismatch\n", c->name);
+    return 1;
+  }
+
+  return 0;
+}
+
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+report(const char *what, const char *name, uint64_t ns, uint64_t ops, uint64_t bytes)
+{
+  double ns_per_op = (double) ns / ops;
+
+  printf("%-14s %-16s %12.1f ns/op", what, name, ns_per_op);
+  if (bytes > 0) {
+    printf(" %10.1f MB/s", (double) bytes * 1000.0 / ns);
+  }
+  printf("\n");
+}
+
+/* BENCH runs body until MIN_BENCH_NS have elapsed, doubling the batch
+ * size each round, then reports the per-iteration cost.
+ */
+#define BENCH(what, name, bytes_per_op, body)                       \
+  do {                                                              \
+    uint64_t __ops = 0, __batch = 1, __start = now_ns(), __ns;      \
+    do {                                                            \
+      for (uint64_t __i = 0; __i < __batch; __i++) {                \
+        body;                                                       \
+      }                                                             \
+      __ops += __batch;                                             \
+      __batch *= 2;                                                 \
+      __ns = now_ns() - __start;                                    \
+    } while (__ns < MIN_BENCH_NS);                                  \
+    report(what, name, __ns, __ops, __ops * (bytes_per_op));        \
+  } while (0)
+
+static unsigned int
+walk_screens(void)
+{
+  unsigned int screens = 0;
+
+  current_data_index = -1;
+  while (set_state_data(true)) {
+    screens++;
+  }
+
+  return screens;
+}
+
+int
+main(void)
+{
+  build_corpus();
+  if (check_corpus()) {
+    return 1;
+  }
+  for (unsigned int i = 0; i < corpus_len; i++) {
+    if (check_compact(&corpus[i])) {
+      return 1;
+    }
+  }
+
+  for (unsigned int i = 0; i < corpus_len; i++) {
+    corpus_entry_t *c = &corpus[i];
+    uint8_t buf[sizeof(c->enc)];
+    txn_t t;
+
+    BENCH("tx_decode", c->name, c->enc_len, {
+      t.accountId = 0;
+      sink += (tx_decode(c->enc, c->enc_len, &t) == TXDEC_OK);
+    });
+
+    // Chunked, copying strings out as the streamed first pass does.
+    BENCH("tx_decoder", c->name, c->enc_len, {
+      tx_decoder_t d;
+      uint8_t txid[32];
+      t.accountId = 0;
+      tx_decoder_init_arena(&d, &t, buf, sizeof(buf));
+      for (unsigned int off = 0; off < c->enc_len; off += STREAM_CHUNK) {
+        unsigned int n = c->enc_len - off;
+        tx_decoder_feed(&d, &t, c->enc + off, n < STREAM_CHUNK ? n : STREAM_CHUNK);
+      }
+      sink += (tx_decoder_finish(&d, &t, txid) == TXDEC_OK);
+    });
+
+    BENCH("tx_encode", c->name, c->enc_len, {
+      sink += tx_encode(&c->txn, buf, sizeof(buf));
+    });
+
+    current_txn = c->txn;
+    BENCH("ui review", c->name, 0, {
+      ui_txn(NULL);
+    });
+    BENCH("ui screens", c->name, 0, {
+      sink += walk_screens();
+    });
+
+    // The expert review, from the transaction ID.
+    uint8_t txid[32];
+    fill(txid, sizeof(txid), i);
+    host_expert_mode = true;
+    ui_txn(txid);
+    BENCH("ui expert", c->name, 0, {
+      sink += walk_screens();
+    });
+    host_expert_mode = false;
+    ui_txn(NULL);
+  }
+
+  // The first corpus entry is a payment.
+  uint8_t receiver[32], delta[64];
+  fill(receiver, sizeof(receiver), 16);
+  unsigned int delta_len = build_delta(delta, receiver);
+  if (check_delta(&corpus[0], delta, delta_len) || check_delta_strings()) {
+    return 1;
+  }
+
+  {
+    corpus_entry_t *c = &corpus[0];
+    uint8_t buf[sizeof(c->enc)], arena[STRINGS_ARENA_SIZE];
+    txn_t t;
+
+    memset(&t, 0, sizeof(t));
+    tx_decode(c->enc, c->enc_len, &t);
+    BENCH("tx_delta", c->name, delta_len, {
+      txn_t d = t;
+      sink += tx_apply_delta(&d, delta, delta_len, arena, sizeof(arena));
+      sink += tx_encode(&d, buf, sizeof(buf));
+    });
+  }
+
+  // A payment on a known network, as a wallet would send it.
+  {
+    corpus_entry_t c = corpus[0];
+    uint8_t compact[sizeof(c.enc)], buf[sizeof(c.enc)], arena[STRINGS_ARENA_SIZE];
+
+    set_view(&c.txn, &c.txn.genesisID, tx_networks[TX_NETWORK_TESTNET].id);
+    memcpy(c.txn.genesisHash, tx_networks[TX_NETWORK_TESTNET].hash, 32);
+    c.enc_len = tx_encode(&c.txn, c.enc, sizeof(c.enc));
+    if (check_compact(&c)) {
+      return 1;
+    }
+
+    unsigned int compact_len = build_compact(&c.txn, compact);
+    BENCH("tx_compact", c.name, compact_len, {
+      txn_t t;
+      memset(&t, 0, sizeof(t));
+      sink += tx_decode_compact(&t, compact, compact_len, arena, sizeof(arena));
+      sink += tx_encode(&t, buf, sizeof(buf));
+    });
+  }
+
+  uint8_t publicKey[32];
+  char checksummed[65];
+  unsigned char b32[65];
+  fill(publicKey, sizeof(publicKey), 42);
+
+  BENCH("checksum_addr", "32-byte key", 32, {
+    checksummed_addr(publicKey, checksummed);
+    sink += checksummed[0];
+  });
+
+  BENCH("base32_encode", "32 bytes", sizeof(publicKey), {
+    base32_encode(publicKey, sizeof(publicKey), b32);
+    sink += b32[0];
+  });
+
+  return 0;
+}
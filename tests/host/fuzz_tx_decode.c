@@ -0,0 +1,58 @@
+/* libFuzzer entry point for the msgpack decoder: any input must either
+ * be rejected or decode to a transaction that re-encodes to the same
+ * bytes, since the device signs accepted bytes as they stand.
+ */
+#include "os.h"
+#include "algo_tx.h"
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static uint8_t enc[4096];
+  txn_t t;
+
+  memset(&t, 0, sizeof(t));
+  if (tx_decode((uint8_t *) data, size, &t) != TXDEC_OK) {
+    return 0;
+  }
+
+  // Only the preview of a longer note, and the digests of programs
+  // and arrays, are kept, so these cannot be encoded again.
+  if (t.note_len > sizeof(t.note)) {
+    return 0;
+  }
+
+  if (t.type == APPLICATION &&
+      (t.application.args.len || t.application.accounts.len ||
+       t.application.foreign_apps.len || t.application.foreign_assets.len ||
+       t.application.aprog.len || t.application.cprog.len)) {
+    return 0;
+  }
+
+  unsigned int len = tx_encode(&t, enc, sizeof(enc));
+  if (len != size || memcmp(enc, data, size) != 0) {
+    abort();
+  }
+
+  // Strings copied to an arena, one byte at a time, must make no
+  // difference.
+  static uint8_t arena[4096];
+  tx_decoder_t d;
+  uint8_t txid[32];
+
+  memset(&t, 0, sizeof(t));
+  tx_decoder_init_arena(&d, &t, arena, sizeof(arena));
+  for (size_t i = 0; i < size; i++) {
+    tx_decoder_feed(&d, &t, data + i, 1);
+  }
+  if (tx_decoder_finish(&d, &t, txid) != TXDEC_OK) {
+    abort();
+  }
+
+  len = tx_encode(&t, enc, sizeof(enc));
+  if (len != size || memcmp(enc, data, size) != 0) {
+    abort();
+  }
+
+  return 0;
+}
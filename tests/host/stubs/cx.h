@@ -0,0 +1,33 @@
+/* Host stand-in for the cx_* hashes used by the codec core. */
+#ifndef HOST_CX_H
+#define HOST_CX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CX_LAST 1
+
+typedef struct {
+  int algo;
+} cx_hash_t;
+
+/* acc holds the 8 state words in host byte order, as on the device. */
+typedef struct {
+  cx_hash_t header;
+  unsigned int blen;
+  uint8_t block[128];
+  uint8_t acc[64];
+  uint64_t len;
+} cx_sha512_t;
+
+typedef struct {
+  int curve;
+  unsigned int d_len;
+  uint8_t d[32];
+} cx_ecfp_private_key_t;
+
+int cx_sha512_init(cx_sha512_t *hash);
+int cx_hash(cx_hash_t *hash, int mode, const uint8_t *in, unsigned int len,
+            uint8_t *out, unsigned int out_len);
+
+#endif
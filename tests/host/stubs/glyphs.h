@@ -0,0 +1,9 @@
+/* Host stand-in for the generated glyphs. */
+#ifndef HOST_GLYPHS_H
+#define HOST_GLYPHS_H
+
+extern const int C_icon_eye;
+extern const int C_icon_validate_14;
+extern const int C_icon_crossmark;
+
+#endif
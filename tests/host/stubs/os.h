@@ -0,0 +1,51 @@
+/* Host stand-in for the parts of the BOLOS os.h used by the codec core. */
+#ifndef HOST_OS_H
+#define HOST_OS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#define os_memmove  memmove
+#define os_memset   memset
+#define os_memcmp   memcmp
+
+#define PRINTF(...)
+#define PIC(x)      (x)
+
+#define U4BE(buf, off) (((uint32_t)(buf)[off] << 24) | ((uint32_t)(buf)[(off)+1] << 16) | \
+                        ((uint32_t)(buf)[(off)+2] << 8) | (uint32_t)(buf)[(off)+3])
+
+#define INVALID_PARAMETER   2
+#define EXCEPTION_IO_RESET  0x10
+
+/* TRY/CATCH on top of setjmp, with the same block structure as the SDK:
+ *
+ *   BEGIN_TRY { TRY { ... } CATCH_OTHER(e) { ... } FINALLY { ... } } END_TRY;
+ */
+extern jmp_buf *host_try_context;
+
+#define BEGIN_TRY                                                   \
+  {                                                                 \
+    jmp_buf __try_jb;                                               \
+    jmp_buf *__try_prev = host_try_context;                         \
+    host_try_context = &__try_jb;                                   \
+    int __try_e = setjmp(__try_jb);
+#define TRY             if (__try_e == 0)
+#define CATCH(x)        else if (host_try_context = __try_prev, __try_e == (x))
+#define CATCH_OTHER(e)  else for (int e = (host_try_context = __try_prev, __try_e), __once = 1; \
+                                  __once; __once = 0, (void) e)
+#define CATCH_ALL       else if (host_try_context = __try_prev, 1)
+#define FINALLY         host_try_context = __try_prev; if (1)
+#define END_TRY         }
+#define CLOSE_TRY       host_try_context = __try_prev
+
+#define THROW(x)        longjmp(*host_try_context, (x))
+
+void os_sched_exit(int code);
+
+#endif
@@ -0,0 +1,9 @@
+/* Host stand-in: nothing from the SEPROXYHAL is needed off-device. */
+#ifndef HOST_OS_IO_SEPROXYHAL_H
+#define HOST_OS_IO_SEPROXYHAL_H
+
+#include "os.h"
+
+void io_seproxyhal_io_heartbeat(void);
+
+#endif
@@ -0,0 +1,178 @@
+/* Host implementations of the SDK services used by the codec core. */
+#include "os.h"
+#include "cx.h"
+#include "ux.h"
+#include "glyphs.h"
+
+#include "algo_keys.h"
+#include "algo_tx.h"
+
+jmp_buf *host_try_context;
+
+txn_t current_txn;
+
+ux_state_t G_ux;
+
+const int C_icon_eye;
+const int C_icon_validate_14;
+const int C_icon_crossmark;
+
+void
+os_sched_exit(int code)
+{
+  fprintf(stderr, "os_sched_exit(%d)\n", code);
+  exit(1);
+}
+
+void io_seproxyhal_io_heartbeat(void) {}
+
+void ux_flow_init(unsigned int slot, const ux_flow_step_t * const *steps, const ux_flow_step_t *start) {}
+void ux_flow_next(void) {}
+void ux_flow_prev(void) {}
+void ux_flow_relayout(void) {}
+void ux_stack_push(void) {}
+
+bool host_expert_mode;
+
+bool
+ui_expert_mode(void)
+{
+  return host_expert_mode;
+}
+
+/* There is no seed on the host: every account gets the same fixed key,
+ * which never matches a transaction sender in the benchmark corpus.
+ */
+size_t
+fetch_public_key(uint32_t accountId, uint8_t *pubkey)
+{
+  memset(pubkey, 0xee, 32);
+  return 32;
+}
+
+/* SHA512 (FIPS 180-4), keeping the state in acc like the SDK does. */
+
+static const uint64_t sha512_k[80] = {
+  0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+  0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+  0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+  0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+  0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+  0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+  0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+  0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+  0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+  0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+  0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+  0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+  0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+  0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+  0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+  0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+  0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+  0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+  0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+  0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static void
+sha512_block(cx_sha512_t *h, const uint8_t *block)
+{
+  uint64_t s[8], w[80];
+
+  memcpy(s, h->acc, sizeof(s));
+
+  for (int i = 0; i < 16; i++) {
+    w[i] = 0;
+    for (int j = 0; j < 8; j++) {
+      w[i] = (w[i] << 8) | block[i*8 + j];
+    }
+  }
+
+  for (int i = 16; i < 80; i++) {
+    uint64_t s0 = ROTR64(w[i-15], 1) ^ ROTR64(w[i-15], 8) ^ (w[i-15] >> 7);
+    uint64_t s1 = ROTR64(w[i-2], 19) ^ ROTR64(w[i-2], 61) ^ (w[i-2] >> 6);
+    w[i] = w[i-16] + s0 + w[i-7] + s1;
+  }
+
+  uint64_t a = s[0], b = s[1], c = s[2], d = s[3];
+  uint64_t e = s[4], f = s[5], g = s[6], k = s[7];
+
+  for (int i = 0; i < 80; i++) {
+    uint64_t t1 = k + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) + ((e & f) ^ (~e & g)) + sha512_k[i] + w[i];
+    uint64_t t2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+    k = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+
+  s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+  s[4] += e; s[5] += f; s[6] += g; s[7] += k;
+
+  memcpy(h->acc, s, sizeof(s));
+}
+
+int
+cx_sha512_init(cx_sha512_t *h)
+{
+  static const uint64_t iv[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+  };
+
+  memset(h, 0, sizeof(*h));
+  memcpy(h->acc, iv, sizeof(iv));
+  return 0;
+}
+
+int
+cx_hash(cx_hash_t *hash, int mode, const uint8_t *in, unsigned int len,
+        uint8_t *out, unsigned int out_len)
+{
+  cx_sha512_t *h = (cx_sha512_t *) hash;
+
+  h->len += len;
+  while (len > 0) {
+    unsigned int n = sizeof(h->block) - h->blen;
+    if (n > len) {
+      n = len;
+    }
+
+    memcpy(&h->block[h->blen], in, n);
+    h->blen += n;
+    in += n;
+    len -= n;
+
+    if (h->blen == sizeof(h->block)) {
+      sha512_block(h, h->block);
+      h->blen = 0;
+    }
+  }
+
+  if (!(mode & CX_LAST)) {
+    return 0;
+  }
+
+  uint64_t bits = h->len * 8;
+  h->block[h->blen++] = 0x80;
+  if (h->blen > 112) {
+    memset(&h->block[h->blen], 0, sizeof(h->block) - h->blen);
+    sha512_block(h, h->block);
+    h->blen = 0;
+  }
+
+  memset(&h->block[h->blen], 0, sizeof(h->block) - h->blen);
+  for (int i = 0; i < 8; i++) {
+    h->block[127 - i] = bits >> (8*i);
+  }
+  sha512_block(h, h->block);
+
+  uint64_t s[8];
+  memcpy(s, h->acc, sizeof(s));
+  for (unsigned int i = 0; i < 64 && i < out_len; i++) {
+    out[i] = s[i/8] >> (56 - 8*(i%8));
+  }
+
+  return 64;
+}
@@ -0,0 +1,39 @@
+/* Host stand-in for the UX flow macros, so that ui_txn.c compiles and
+ * its formatters can be driven directly through set_state_data().
+ */
+#ifndef HOST_UX_H
+#define HOST_UX_H
+
+#include "os_io_seproxyhal.h"
+
+typedef struct {
+  int unused;
+} ux_flow_step_t;
+
+typedef struct {
+  unsigned int index;
+  unsigned int prev_index;
+} ux_flow_state_t;
+
+typedef struct {
+  ux_flow_state_t flow_stack[1];
+  unsigned int stack_count;
+} ux_state_t;
+
+extern ux_state_t G_ux;
+
+#define UX_STEP_NOCB(name, layout, ...)           const ux_flow_step_t name = {0}
+#define UX_STEP_CB(name, layout, cb, ...)         const ux_flow_step_t name = {0}
+#define UX_STEP_INIT(name, a, b, ...)             const ux_flow_step_t name = {0}
+#define UX_FLOW_DEF_NOCB(name, layout, ...)       const ux_flow_step_t name = {0}
+#define UX_FLOW_DEF_VALID(name, layout, cb, ...)  const ux_flow_step_t name = {0}
+#define UX_FLOW(name, ...)                        const ux_flow_step_t * const name[] = { __VA_ARGS__, NULL }
+#define FLOW_LOOP NULL
+
+void ux_flow_init(unsigned int slot, const ux_flow_step_t * const *steps, const ux_flow_step_t *start);
+void ux_flow_next(void);
+void ux_flow_prev(void);
+void ux_flow_relayout(void);
+void ux_stack_push(void);
+
+#endif
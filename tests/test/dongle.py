@@ -20,6 +20,7 @@ class Dongle:
         self.apdu_port = apdu_port
         self.automation_port = automation_port
         self.button_port = button_port
+        self.debug = debug
         self.dongle = ledgerblue.commTCP.getDongle(server='127.0.0.1',
                                                    port=self.apdu_port,
                                                    debug=debug)
@@ -30,6 +31,12 @@ class Dongle:
     def close(self):
         self.dongle.close()
 
+    def reconnect(self):
+        self.dongle.close()
+        self.dongle = ledgerblue.commTCP.getDongle(server='127.0.0.1',
+                                                   port=self.apdu_port,
+                                                   debug=self.debug)
+
     @contextmanager
     def screen_event_handler(self, handler):
         def do_handle_events(_handler, _fd):
@@ -121,3 +121,30 @@ def test_ins_with_non_0_account_does_not_return_account_0_key(dongle, account_ap
         logging.error(e)
         assert False
 
+
+def test_bulk_keys_match_single_keys(dongle):
+    """
+    `INS_GET_PUBLIC_KEYS` (0x0B) returns the keys of consecutive
+    accounts, as many as fit in a response by default.
+    """
+    keys = dongle.exchange(struct.pack('>BBBBBI', 0x80, 0xb, 0x0, 0x0, 0x4, 3))
+    assert len(keys) == 7 * 32
+    for i in range(7):
+        key = dongle.exchange(struct.pack('>BBBBBI', 0x80, 0x3, 0x0, 0x0, 0x4, 3 + i))
+        assert keys[32 * i:32 * (i + 1)] == key
+
+    keys = dongle.exchange(struct.pack('>BBBBBIB', 0x80, 0xb, 0x0, 0x0, 0x5, 3, 2))
+    assert len(keys) == 2 * 32
+
+
+def test_find_account(dongle):
+    """
+    `INS_FIND_ACCOUNT` (0x0C) derives keys until one matches.
+    """
+    key = dongle.exchange(struct.pack('>BBBBBI', 0x80, 0x3, 0x0, 0x0, 0x4, 42))
+    apdu = struct.pack('>BBBBB32sII', 0x80, 0xc, 0x0, 0x0, 40, key, 0, 50)
+    assert dongle.exchange(apdu) == struct.pack('>I', 42)
+
+    with pytest.raises(speculos.CommException) as excinfo:
+        dongle.exchange(struct.pack('>BBBBB32sII', 0x80, 0xc, 0x0, 0x0, 40, key, 0, 42))
+    assert excinfo.value.sw == 0x6a88
@@ -1,7 +1,10 @@
 import pytest
+import re
 import logging
 import struct
 import base64
+import binascii
+import time
 
 import msgpack
 import nacl.signing
@@ -13,7 +16,9 @@ from . import speculos
 
 labels = {
     'review', 'txn type', 'sender', 'fee', 'first valid', 'last valid',
-    'genesis', 'note', 'receiver', 'amount', 'sign'
+    'genesis', 'note', 'receiver', 'amount', 'app id', 'on completion',
+    'app args', 'accounts', 'foreign', 'prog', 'schema', 'group', 'fees',
+    'sent', 'txn ', 'sign'
 }
 
 
@@ -82,6 +87,557 @@ def test_sign_msgpack_returns_same_signature(dongle, txn):
     assert txnSig == defaultTxnSig
 
 
+@pytest.mark.parametrize('mutate', [
+    # keys out of canonical order
+    lambda d: msgpack.packb(dict(reversed(list(d.items()))), use_bin_type=True),
+    # zero-valued field that canonical encoding omits
+    lambda d: msgpack.packb(dict(sorted({**d, 'lv': 0}.items())), use_bin_type=True),
+    # trailing bytes after the transaction map
+    lambda d: msgpack.packb(d, use_bin_type=True) + b'\x00',
+    # string whose tail would be hidden from review behind a NUL
+    lambda d: msgpack.packb(dict(sorted({**d, 'gen': 'testnet\x00-v1.0'}.items())), use_bin_type=True),
+])
+def test_sign_msgpack_rejects_non_canonical_encoding(dongle, txn, mutate):
+    """
+    Since the received bytes are signed as-is, anything but the
+    canonical encoding must be rejected before review.
+    """
+    d = msgpack.unpackb(txn, raw=False)
+    resp = sign_algo_txn(dongle, mutate(d))
+    assert len(resp) > 65
+    assert resp[:65] == bytes(65)
+
+
+def test_sign_msgpack_stream_matches_single_pass(dongle, txn):
+    """
+    The two-pass protocol produces the same (deterministic) signature
+    as INS_SIGN_MSGPACK for the same transaction and account.
+    """
+    with dongle.screen_event_handler(txn_ui_handler):
+        txnSig = sign_algo_txn(dongle, txn)
+
+    with dongle.screen_event_handler(txn_ui_handler):
+        txid = sign_algo_txn(dongle, txn, ins=0x09)
+    assert len(txid) == 32
+
+    streamSig = sign_algo_txn(dongle, txn, ins=0x09, p1=0x40)
+    assert streamSig == txnSig
+
+
+def test_sign_msgpack_stream_rejects_different_second_pass(dongle, txn):
+    """
+    A second pass whose bytes differ from the reviewed first pass is
+    refused with 0x6A80 instead of signed.
+    """
+    with dongle.screen_event_handler(txn_ui_handler):
+        sign_algo_txn(dongle, txn, ins=0x09)
+
+    tampered = txn[:-1] + bytes([txn[-1] ^ 1])
+    with pytest.raises(speculos.CommException) as excinfo:
+        sign_algo_txn(dongle, tampered, ins=0x09, p1=0x40)
+    assert excinfo.value.sw == 0x6a80
+
+
+def test_sign_msgpack_stream_with_1k_note(dongle, txn):
+    """
+    Notes up to the protocol's 1 KB limit are accepted on every device,
+    since only a preview and digest of the note are kept.
+    """
+    pubKey = get_public_key(dongle)
+
+    d = msgpack.unpackb(txn, raw=False)
+    d['note'] = bytes(range(256)) * 4
+    txn = msgpack.packb(d, use_bin_type=True)
+
+    with dongle.screen_event_handler(txn_ui_handler):
+        sign_algo_txn(dongle, txn, ins=0x09)
+    txnSig = sign_algo_txn(dongle, txn, ins=0x09, p1=0x40)
+
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + txn, signature=txnSig)
+
+
+def test_sign_msgpack_stream_app_call(dongle, txn):
+    """
+    Application calls are reviewed from counts and digests of their
+    arrays and programs, so a program bigger than the receive buffer
+    can still be signed.
+    """
+    pubKey = get_public_key(dongle)
+
+    d = msgpack.unpackb(txn, raw=False)
+    del d['amt'], d['rcv']
+    d.update({
+        'type': 'appl',
+        'apid': 1284326447,
+        'apan': 1,
+        'apaa': [b'', b'opt-in', bytes(300)],
+        'apat': [d['snd']],
+        'apfa': [0, 1284326448],
+        'apap': bytes(range(256)) * 8,
+        'apsu': b'\x06\x81\x01',
+        'apgs': {'nbs': 1, 'nui': 3},
+    })
+    txn = msgpack.packb(dict(sorted(d.items())), use_bin_type=True)
+
+    with dongle.screen_event_handler(txn_ui_handler):
+        sign_algo_txn(dongle, txn, ins=0x09)
+    txnSig = sign_algo_txn(dongle, txn, ins=0x09, p1=0x40)
+
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + txn, signature=txnSig)
+
+
+def test_sign_msgpack_stream_rejects_long_app_args(dongle, txn):
+    """
+    Application call arguments are refused before review once their
+    total length exceeds the protocol's 2048 bytes.
+    """
+    d = msgpack.unpackb(txn, raw=False)
+    del d['amt'], d['rcv']
+    d.update({'type': 'appl', 'apid': 1284326447, 'apaa': [bytes(1500), bytes(600)]})
+    txn = msgpack.packb(dict(sorted(d.items())), use_bin_type=True)
+
+    resp = sign_algo_txn(dongle, txn, ins=0x09)
+    assert resp[:65] == bytes(65)
+    assert b'app args' in resp[65:]
+
+def test_sign_group(dongle, txn):
+    """
+    A group is reviewed once; then each member to sign is sent again
+    and signed, and the other members are only shown.
+    """
+    pubKey = get_public_key(dongle)
+
+    gid, members = group_of_payments(txn, 2)
+    with dongle.screen_event_handler(txn_ui_handler):
+        resp = upload_group(dongle, members, signed=[0])
+    assert resp == gid
+
+    txnSig = sign_algo_txn(dongle, bytes([0]) + members[0], p1=0x40, ins=0x0a)
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + members[0], signature=txnSig)
+
+    # Only the members sent with an account are signed.
+    with pytest.raises(speculos.CommException) as excinfo:
+        sign_algo_txn(dongle, bytes([1]) + members[1], p1=0x40, ins=0x0a)
+    assert excinfo.value.sw == 0x6a80
+
+
+def test_signing_session_timing(dongle, txn):
+    """
+    Compares the time spent signing the members of an approved group
+    with and without a signing session, which skips the key derivation
+    of every signature but the first.
+    """
+    pubKey = get_public_key(dongle)
+    verify_key = nacl.signing.VerifyKey(pubKey)
+
+    gid, members = group_of_payments(txn, 4)
+    sigs = {}
+    for session in (0x00, 0x01):
+        dongle.exchange(struct.pack('>BBBBB', 0x80, 0xd, session, 0x0, 0x0))
+
+        start = time.perf_counter()
+        with dongle.screen_event_handler(txn_ui_handler):
+            upload_group(dongle, members, signed=range(len(members)))
+        review = time.perf_counter() - start
+
+        start = time.perf_counter()
+        sigs[session] = [sign_algo_txn(dongle, bytes([i]) + m, p1=0x40, ins=0x0a)
+                         for i, m in enumerate(members)]
+        signing = time.perf_counter() - start
+
+        logging.warning('session %d: upload and review %.3fs, %d signatures %.3fs',
+                        session, review, len(members), signing)
+
+    dongle.exchange(struct.pack('>BBBBB', 0x80, 0xd, 0x00, 0x0, 0x0))
+    assert sigs[0x00] == sigs[0x01]
+    for sig, member in zip(sigs[0x01], members):
+        verify_key.verify(smessage=b'TX' + member, signature=sig)
+
+
+def test_sign_under_payment_policy(dongle, txn):
+    """
+    Once a payment policy is approved, matching payments are signed
+    without review.
+    """
+    pubKey = get_public_key(dongle)
+
+    d = msgpack.unpackb(txn, raw=False)
+    d['snd'] = pubKey
+    txn = msgpack.packb(d, use_bin_type=True)
+
+    apdu = struct.pack('>BBBBBIQ32sQ', 0x80, 0xe, 0x2, 0x0, 52, 0, 1000, d['rcv'], 1000000)
+    with dongle.screen_event_handler(policy_ui_handler):
+        dongle.exchange(apdu)
+
+    txnSig = sign_algo_txn(dongle, txn)
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + txn, signature=txnSig)
+
+    dongle.exchange(struct.pack('>BBBBB', 0x80, 0xe, 0x0, 0x0, 0x0))
+
+
+def test_keyreg_policy_refuses_nonpart(dongle, txn):
+    """
+    A key registration policy only lets online registrations through:
+    one that marks the account non-participating goes to review, where
+    it is cancelled here.
+    """
+    pubKey = get_public_key(dongle)
+
+    d = msgpack.unpackb(txn, raw=False)
+    del d['amt'], d['rcv']
+    d.update({'snd': pubKey, 'type': 'keyreg', 'nonpart': True})
+    txn = msgpack.packb(dict(sorted(d.items())), use_bin_type=True)
+
+    apdu = struct.pack('>BBBBBIQQQ', 0x80, 0xe, 0x1, 0x0, 28, 0, 1000, 0, 2**64 - 1)
+    with dongle.screen_event_handler(policy_ui_handler):
+        dongle.exchange(apdu)
+
+    with dongle.screen_event_handler(cancel_ui_handler):
+        with pytest.raises(speculos.CommException) as excinfo:
+            sign_algo_txn(dongle, txn)
+    assert excinfo.value.sw == 0x6985
+
+    dongle.exchange(struct.pack('>BBBBB', 0x80, 0xe, 0x0, 0x0, 0x0))
+
+
+def cancel_ui_handler(event, buttons):
+    label = screen_label(event)
+    if label == "cancel":
+        buttons.press(buttons.RIGHT, buttons.LEFT, buttons.RIGHT_RELEASE, buttons.LEFT_RELEASE)
+    else:
+        buttons.press(buttons.RIGHT, buttons.RIGHT_RELEASE)
+
+
+def policy_ui_handler(event, buttons):
+    label = screen_label(event)
+    if label == "approve":
+        buttons.press(buttons.RIGHT, buttons.LEFT, buttons.RIGHT_RELEASE, buttons.LEFT_RELEASE)
+    # "Sign without review" is cut short to make room for its position
+    elif label.startswith(("review", "sign without", "account", "max fee (alg)",
+                           "receiver", "max amount (alg)", "vote from", "vote until")):
+        buttons.press(buttons.RIGHT, buttons.RIGHT_RELEASE)
+
+
+def test_sign_msgpack_returns_signed_txn(dongle, txn):
+    """
+    With bit 1 of `P1` set, the response is the SignedTxn, read back
+    with `INS_GET_SIGNED_TXN` (0x11) past the first response.
+    """
+    pubKey = get_public_key(dongle)
+
+    with dongle.screen_event_handler(txn_ui_handler):
+        resp = sign_algo_txn(dongle, txn, p1=0x02)
+    length = struct.unpack('>H', resp[:2])[0]
+    stxn = resp[2:]
+    while len(stxn) < length:
+        stxn += dongle.exchange(struct.pack('>BBBBBH', 0x80, 0x11, 0x0, 0x0, 0x2, len(stxn)))
+
+    # The fixture's sender is not the device's key
+    d = msgpack.unpackb(stxn, raw=False)
+    assert d['sgnr'] == pubKey
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + txn, signature=d['sig'])
+    assert stxn == msgpack.packb({'sgnr': pubKey, 'sig': d['sig'],
+                                  'txn': msgpack.unpackb(txn, raw=False)},
+                                 use_bin_type=True)
+
+
+def test_get_last_signature(dongle, txn):
+    """
+    `INS_GET_LAST_SIGNATURE` (0x14) returns the last signature again,
+    by transaction ID.
+    """
+    with dongle.screen_event_handler(txn_ui_handler):
+        txnSig = sign_algo_txn(dongle, txn)
+    txid = algosdk.encoding.checksum(b'TX' + txn)
+
+    apdu = struct.pack('>BBBBB32s', 0x80, 0x14, 0x0, 0x0, 32, txid)
+    assert dongle.exchange(apdu) == txnSig
+    apdu = struct.pack('>BBBBB32sI', 0x80, 0x14, 0x1, 0x0, 36, txid, 0)
+    assert dongle.exchange(apdu) == txnSig
+
+    with pytest.raises(speculos.CommException) as excinfo:
+        dongle.exchange(struct.pack('>BBBBB32sI', 0x80, 0x14, 0x1, 0x0, 36, txid, 1))
+    assert excinfo.value.sw == 0x6a88
+
+
+def test_sign_resumable_skips_lost_and_repeated_chunks(dongle, txn):
+    """
+    `INS_SIGN_RESUMABLE` (0x13) only takes the chunk at the end of the
+    bytes received so far, and tells the host where that is.
+    """
+    pubKey = get_public_key(dongle)
+    assert dongle.exchange(resumable_chunk(0x00, 0x80, 0, txn[:50])) == struct.pack('>H', 50)
+    # Lost, then repeated
+    assert dongle.exchange(resumable_chunk(0x80, 0x80, 100, txn[100:150])) == struct.pack('>H', 50)
+    assert dongle.exchange(resumable_chunk(0x80, 0x80, 0, txn[:50])) == struct.pack('>H', 50)
+
+    bad = bytearray(resumable_chunk(0x80, 0x80, 50, txn[50:100]))
+    bad[-1] ^= 1
+    with pytest.raises(speculos.CommException) as excinfo:
+        dongle.exchange(bytes(bad))
+    assert excinfo.value.sw == 0x6a80
+    # Made the last chunk by a corrupted P2
+    bad = bytearray(resumable_chunk(0x80, 0x80, 50, txn[50:100]))
+    bad[3] = 0x00
+    with pytest.raises(speculos.CommException) as excinfo:
+        dongle.exchange(bytes(bad))
+    assert excinfo.value.sw == 0x6a80
+
+    assert dongle.exchange(resumable_chunk(0x80, 0x80, 50, txn[50:100])) == struct.pack('>H', 100)
+    with dongle.screen_event_handler(txn_ui_handler):
+        txnSig = dongle.exchange(resumable_chunk(0x80, 0x00, 100, txn[100:]))
+
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + txn, signature=txnSig)
+
+
+def test_sign_resumable_survives_reset(dongle, txn):
+    """
+    An `INS_SIGN_RESUMABLE` upload outlives a dropped link: the device
+    still reports the bytes received before it, and signs with the
+    account given in the first chunk.
+    """
+    pubKey = get_public_key(dongle, 1)
+    first = resumable_chunk(0x01, 0x80, 0, struct.pack('>I', 1) + txn[:50])
+    assert dongle.exchange(first) == struct.pack('>H', 50)
+
+    dongle.reconnect()
+
+    assert dongle.exchange(resumable_chunk(0x80, 0x80, 100, txn[100:150])) == struct.pack('>H', 50)
+    assert dongle.exchange(resumable_chunk(0x80, 0x80, 50, txn[50:100])) == struct.pack('>H', 100)
+    with dongle.screen_event_handler(txn_ui_handler):
+        txnSig = dongle.exchange(resumable_chunk(0x80, 0x00, 100, txn[100:]))
+
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + txn, signature=txnSig)
+
+
+def test_sign_delta(dongle, txn):
+    """
+    `INS_SIGN_DELTA` (0x12) signs the last transaction with the fields
+    it lists changed.
+    """
+    pubKey = get_public_key(dongle)
+    with dongle.screen_event_handler(txn_ui_handler):
+        sign_algo_txn(dongle, txn)
+
+    d = msgpack.unpackb(txn, raw=False)
+    d['amt'] = 2500000
+    d['fv'] += 1000
+    d['lv'] += 1000
+    del d['note']
+    next_txn = msgpack.packb(dict(sorted(d.items())), use_bin_type=True)
+
+    delta = b''
+    for key, value in ((b'amt', struct.pack('>I', 2500000)),
+                       (b'fv', struct.pack('>I', d['fv'])),
+                       (b'lv', struct.pack('>I', d['lv'])),
+                       (b'note', b'')):
+        delta += bytes([len(key)]) + key + bytes([len(value)]) + value
+    with dongle.screen_event_handler(txn_ui_handler):
+        txnSig = dongle.exchange(struct.pack('>BBBBB', 0x80, 0x12, 0x0, 0x0, len(delta)) + delta)
+
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + next_txn, signature=txnSig)
+
+
+def test_sign_compact(dongle, txn):
+    """
+    `INS_SIGN_COMPACT` (0x16) signs the canonical encoding of a
+    transaction sent as a field bitmap and packed values.
+    """
+    pubKey = get_public_key(dongle)
+    d = msgpack.unpackb(txn, raw=False)
+
+    # testnet names the genesis.
+    fields = ('amt', 'fee', 'fv', 'lv', 'note', 'rcv', 'snd')
+    bits = sum(1 << COMPACT_FIELD_IDS[k] for k in fields)
+    compact = bytes([1, 1]) + bits.to_bytes(7, 'little')
+    compact += varint(d['amt']) + varint(d['fee']) + varint(d['fv']) + varint(d['lv'])
+    compact += bytes([len(d['note'])]) + d['note'] + d['rcv'] + d['snd']
+    assert len(compact) < len(txn)
+
+    with dongle.screen_event_handler(txn_ui_handler):
+        txnSig = dongle.exchange(struct.pack('>BBBBB', 0x80, 0x16, 0x0, 0x0, len(compact)) + compact)
+
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'TX' + txn, signature=txnSig)
+
+
+def test_sign_multisig_subkeys(dongle, txn):
+    """
+    `INS_SIGN_MULTISIG` (0x10) returns one signature per account after
+    a single review.
+    """
+    accounts = [0, 3, 7]
+    with dongle.screen_event_handler(txn_ui_handler):
+        sigs = sign_algo_txn(dongle, struct.pack('>B3I', 3, *accounts) + txn, ins=0x10)
+
+    assert len(sigs) == 3 * 64
+    for i, account in enumerate(accounts):
+        pubKey = get_public_key(dongle, account)
+        verify_key = nacl.signing.VerifyKey(pubKey)
+        verify_key.verify(smessage=b'TX' + txn, signature=sigs[64 * i:64 * (i + 1)])
+
+    # Not kept for INS_GET_LAST_SIGNATURE
+    txid = algosdk.encoding.checksum(b'TX' + txn)
+    with pytest.raises(speculos.CommException) as excinfo:
+        dongle.exchange(struct.pack('>BBBBB32s', 0x80, 0x14, 0x0, 0x0, 32, txid))
+    assert excinfo.value.sw == 0x6985
+
+
+def test_sign_remembered_program(dongle):
+    """
+    A delegated program the user chose to remember is signed again
+    without review, from the account it was approved for only.
+    """
+    pubKey = get_public_key(dongle)
+    # int 1
+    program = bytes([0x01, 0x20, 0x01, 0x01, 0x22])
+    progHash = algosdk.encoding.checksum(b'Program' + program)
+
+    with dongle.screen_event_handler(program_ui_handler):
+        assert sign_algo_txn(dongle, program, ins=0x0f) == progHash
+    progSig = sign_algo_txn(dongle, program, ins=0x0f, p1=0x40)
+    verify_key = nacl.signing.VerifyKey(pubKey)
+    verify_key.verify(smessage=b'Program' + program, signature=progSig)
+
+    assert sign_algo_txn(dongle, program, ins=0x0f) == progHash
+    assert sign_algo_txn(dongle, program, ins=0x0f, p1=0x40) == progSig
+
+    with dongle.screen_event_handler(cancel_ui_handler):
+        with pytest.raises(speculos.CommException) as excinfo:
+            sign_algo_txn(dongle, struct.pack('>I', 1) + program, ins=0x0f, p1=0x01)
+    assert excinfo.value.sw == 0x6985
+
+    with dongle.screen_event_handler(keep_ui_handler):
+        with pytest.raises(speculos.CommException) as excinfo:
+            dongle.exchange(struct.pack('>BBBBB', 0x80, 0xf, 0x20, 0x0, 0x0))
+    assert excinfo.value.sw == 0x6985
+    assert sign_algo_txn(dongle, program, ins=0x0f) == progHash
+    sign_algo_txn(dongle, program, ins=0x0f, p1=0x40)
+
+    with dongle.screen_event_handler(forget_ui_handler):
+        dongle.exchange(struct.pack('>BBBBB', 0x80, 0xf, 0x20, 0x0, 0x0))
+
+
+def test_get_config(dongle, txn):
+    """
+    `INS_GET_CONFIG` (0x15) reports the signing commands and a buffer
+    large enough for a plain payment.
+    """
+    config = dongle.exchange(struct.pack('>BBBBB', 0x80, 0x15, 0x0, 0x0, 0x0))
+    assert len(config) == 18
+    (ins_bits, txn_max) = struct.unpack('>IH', config[4:10])
+    for ins in (0x03, 0x08, 0x09, 0x15):
+        assert ins_bits & (1 << ins)
+    assert len(txn) <= txn_max
+    assert config[12] == 255
+
+def program_ui_handler(event, buttons):
+    label = screen_label(event)
+    if label == "sign and":
+        buttons.press(buttons.RIGHT, buttons.LEFT, buttons.RIGHT_RELEASE, buttons.LEFT_RELEASE)
+    elif label in ("review", "program", "program addr", "account", "sign"):
+        buttons.press(buttons.RIGHT, buttons.RIGHT_RELEASE)
+
+
+def forget_ui_handler(event, buttons):
+    label = screen_label(event)
+    if label == "forget":
+        buttons.press(buttons.RIGHT, buttons.LEFT, buttons.RIGHT_RELEASE, buttons.LEFT_RELEASE)
+    else:
+        buttons.press(buttons.RIGHT, buttons.RIGHT_RELEASE)
+
+
+def keep_ui_handler(event, buttons):
+    label = screen_label(event)
+    if label == "keep":
+        buttons.press(buttons.RIGHT, buttons.LEFT, buttons.RIGHT_RELEASE, buttons.LEFT_RELEASE)
+    else:
+        buttons.press(buttons.RIGHT, buttons.RIGHT_RELEASE)
+
+
+def group_of_payments(txn, size):
+    pays = []
+    for i in range(size):
+        pay = algosdk.encoding.future_msgpack_decode(base64.b64encode(txn).decode())
+        pay.amt += i * 1000000
+        pays.append(pay)
+    gid = algosdk.transaction.calculate_group_id(pays)
+    for pay in pays:
+        pay.group = gid
+    return gid, [base64.b64decode(algosdk.encoding.msgpack_encode(t)) for t in pays]
+
+
+def get_public_key(dongle, account=None):
+    """
+    Returns the public key of account, of the default account if None.
+    """
+    if account is None:
+        return dongle.exchange(struct.pack('>BBBBB', 0x80, 0x3, 0x0, 0x0, 0x0))
+    return dongle.exchange(struct.pack('>BBBBBI', 0x80, 0x3, 0x0, 0x0, 0x4, account))
+
+
+def resumable_chunk(p1, p2, offset, data):
+    """
+    Returns the `INS_SIGN_RESUMABLE` APDU of the chunk of data at offset,
+    with its CRC over INS, P1, P2 and the rest of the payload.
+    """
+    body = struct.pack('>H', offset) + data
+    crc = binascii.crc_hqx(bytes([0x13, p1, p2]) + body, 0xffff)
+    payload = struct.pack('>H', crc) + body
+    return struct.pack('>BBBBB', 0x80, 0x13, p1, p2, len(payload)) + payload
+
+
+# Wire IDs of the fields of INS_SIGN_COMPACT, bits of its field bitmap,
+# as fixed in tests/README.md.
+COMPACT_FIELD_IDS = {
+    'amt': 3,
+    'fee': 22,
+    'fv': 23,
+    'lv': 27,
+    'note': 30,
+    'rcv': 31,
+    'snd': 34,
+}
+
+
+def varint(n):
+    out = b''
+    while n >= 0x80:
+        out += bytes([(n & 0x7f) | 0x80])
+        n >>= 7
+    return out + bytes([n])
+
+
+def upload_group(dongle, members, signed):
+    """
+    Uploads the members of a group, those in signed with account 0, and
+    returns the last response.
+    """
+    for i, member in enumerate(members):
+        p1 = 0x01 if i in signed else 0x00
+        account = struct.pack('>I', 0) if i in signed else b''
+        resp = sign_algo_txn(dongle, bytes([i, len(members)]) + account + member,
+                             p1=p1, ins=0x0a)
+    return resp
+
+
+def screen_label(event):
+    """
+    Returns the top line of a screen, lowercase, without the "i/N"
+    position that review steps end with.
+    """
+    label = sorted(event, key=lambda e: e['y'])[0]['text'].lower()
+    return re.sub(r' \d+/\d+$', '', label)
+
+
 def txn_ui_handler(event, buttons):
     logging.warning(event)
     label = sorted(event, key=lambda e: e['y'])[0]['text'].lower()
@@ -104,17 +660,17 @@ def chunks(txn, chunk_size=250, first_chunk_size=250):
         yield chunk, last
 
 
-def apdus(chunks, p1=0x00, p2=0x80):
+def apdus(chunks, p1=0x00, p2=0x80, ins=0x08):
     for chunk, last in chunks:
         if last:
             p2 &= ~0x80
         size = len(chunk)
-        yield struct.pack('>BBBBB%ds' % size, 0x80, 0x08, p1, p2, size, chunk)
+        yield struct.pack('>BBBBB%ds' % size, 0x80, ins, p1, p2, size, chunk)
         p1 |= 0x80
 
 
-def sign_algo_txn(dongle, txn, p1=0x00):
-    for apdu in apdus(chunks(txn), p1=p1 & 0x7f):
+def sign_algo_txn(dongle, txn, p1=0x00, ins=0x08):
+    for apdu in apdus(chunks(txn), p1=p1 & 0x7f, ins=ins):
         sig = dongle.exchange(apdu)
     return sig
 